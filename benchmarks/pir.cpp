@@ -3,8 +3,10 @@
 #include <iostream>
 #include <random>
 #include <memory>
+#include <string>
 
 #include "she.hpp"
+#include "she/database.hpp"
 #include "utils.hpp"
 
 using std::cout;
@@ -19,6 +21,7 @@ using she::ParameterSet;
 using she::CompressedCiphertext;
 using she::EncryptedArray;
 using she::PlaintextArray;
+using she::PlaintextDatabase;
 
 
 vector<bool> dec_to_bits(unsigned int num, unsigned int bit_size)
@@ -51,15 +54,6 @@ randomly_populate_database( vector<PlaintextArray> * database
     }
 }
 
-void build_database_indexes( vector<PlaintextArray> * database_indexes
-                         , unsigned int database_size
-                         , unsigned int index_size)
-{
-    for (unsigned int i = 0; i < database_size; ++i) {
-        database_indexes->push_back(dec_to_bits(i, index_size));
-    }
-}
-
 PrivateKey generate_key( unsigned int security
                        , unsigned int record_size)
 {
@@ -96,12 +90,11 @@ EncryptedArray expand_ciphertext(const CompressedCiphertext & ctxt)
 }
 
 EncryptedArray
-calculate_selection_vector( const EncryptedArray & query
-                          , const vector<PlaintextArray> & database_indexes)
+calculate_selection_vector(const EncryptedArray & query)
 {
     START_TIMER("SELECTION VECTOR HOMOMORPHIC CALCULATION", "SERVER");
 
-    auto result = query.equal(database_indexes);
+    auto result = query.demux();
 
     END_TIMER();
     return result;
@@ -119,6 +112,29 @@ calculate_response( const EncryptedArray & sv
     return result;
 }
 
+PlaintextDatabase
+transpose_database(const vector<PlaintextArray> & database)
+{
+    START_TIMER("COLUMN-MAJOR DATABASE PREPARATION", "PREPARATION");
+
+    auto result = PlaintextDatabase(database);
+
+    END_TIMER();
+    return result;
+}
+
+EncryptedArray
+calculate_response( const EncryptedArray & sv
+                  , const PlaintextDatabase & database)
+{
+    START_TIMER("RESPONSE HOMOMORPHIC CALCULATION (COLUMN-MAJOR)", "SERVER");
+
+    auto result = sv.select(database);
+
+    END_TIMER();
+    return result;
+}
+
 PlaintextArray
 decrypt_response( const PrivateKey & sk
                   , const EncryptedArray & response)
@@ -132,10 +148,13 @@ decrypt_response( const PrivateKey & sk
 }
 
 
-int main()
+int main(int argc, char * argv[])
 {
     srand (time(NULL));
 
+    // Run as `pir columns` to select from a column-major database
+    const bool column_major = (argc > 1) && (std::string(argv[1]) == "columns");
+
     // Security level. 62 for 62-bit security
     unsigned int security = 62;
 
@@ -152,16 +171,13 @@ int main()
     cout << "Security:      " << security << endl;
     cout << "Database size: " << database_size << endl;
     cout << "Record size:   " << record_size << endl;
-    cout << "Index size:    " << index_size << endl << endl;
+    cout << "Index size:    " << index_size << endl;
+    cout << "Layout:        " << (column_major ? "column-major" : "row-major") << endl << endl;
 
     // Preparation: Generate random database
     vector<PlaintextArray> database;
     randomly_populate_database(&database, database_size, record_size);
 
-    // Preparation: Generate database indexes
-    vector<PlaintextArray> database_indexes;
-    build_database_indexes(&database_indexes, database_size, index_size);
-
     // Generate key
     const auto sk = move(generate_key(security, index_size));
 
@@ -174,10 +190,12 @@ int main()
     const auto encrypted_query = move(expand_ciphertext(compressed_ciphertext));
 
     // Calculate homomorphic selection vector
-    const auto selector = move(calculate_selection_vector(encrypted_query, database_indexes));
+    const auto selector = move(calculate_selection_vector(encrypted_query));
 
     // Homomorphically calculate response
-    const auto encrypted_response = move(calculate_response(selector, database));
+    const auto encrypted_response = column_major
+        ? calculate_response(selector, transpose_database(database))
+        : calculate_response(selector, database);
 
     // Decrypt response
     std::vector<bool> response = move(decrypt_response(sk, encrypted_response));
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <vector>
+
+#include <gmpxx.h>
+
+#include "she/reduction.hpp"
+#include "utils.hpp"
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+using she::ReductionContext;
+
+
+void
+reduce_with_division( const mpz_class & modulus
+                    , const vector<mpz_class> & lhs
+                    , const vector<mpz_class> & rhs
+                    , vector<mpz_class> * sums
+                    , vector<mpz_class> * products)
+{
+    START_TIMER("SUMS AND PRODUCTS, MODULAR DIVISION", "DIVISION");
+
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        (*sums)[i] = lhs[i] + rhs[i];
+        (*sums)[i] %= modulus;
+        (*products)[i] = lhs[i] * rhs[i];
+        (*products)[i] %= modulus;
+    }
+
+    END_TIMER();
+}
+
+void
+reduce_with_context( const ReductionContext & context
+                   , const vector<mpz_class> & lhs
+                   , const vector<mpz_class> & rhs
+                   , vector<mpz_class> * sums
+                   , vector<mpz_class> * products)
+{
+    START_TIMER("SUMS AND PRODUCTS, REDUCTION CONTEXT", "CONTEXT");
+
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        (*sums)[i] = lhs[i] + rhs[i];
+        context.reduce((*sums)[i]);
+        (*products)[i] = lhs[i] * rhs[i];
+        context.reduce((*products)[i]);
+    }
+
+    END_TIMER();
+}
+
+
+int main()
+{
+    gmp_randclass generator(gmp_randinit_default);
+    generator.seed(42);
+
+    // Size of the public element in bits
+    unsigned int modulus_size = 1 << 20;
+
+    // Number of operations of every kind
+    unsigned int iterations = 64;
+
+    cout << "Modulus size: " << modulus_size << endl;
+    cout << "Iterations:   " << iterations << endl << endl;
+
+    const mpz_class modulus = generator.get_z_bits(modulus_size) | (mpz_class(1) << (modulus_size - 1));
+
+    vector<mpz_class> lhs, rhs;
+    for (unsigned int i = 0; i < iterations; ++i) {
+        lhs.push_back(generator.get_z_range(modulus));
+        rhs.push_back(generator.get_z_range(modulus));
+    }
+
+    vector<mpz_class> expected_sums(iterations), expected_products(iterations);
+    reduce_with_division(modulus, lhs, rhs, &expected_sums, &expected_products);
+
+    const ReductionContext context(modulus);
+    vector<mpz_class> sums(iterations), products(iterations);
+    reduce_with_context(context, lhs, rhs, &sums, &products);
+
+    TIMER_STATS();
+
+    cout << "Correct result? " << std::boolalpha
+         << (sums == expected_sums && products == expected_products) << endl;
+
+    return 0;
+}
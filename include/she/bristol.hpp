@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "ciphertext.hpp"
+#include "plaintext.hpp"
+
+
+namespace she
+{
+
+// Boolean circuit in Bristol fashion. Supported gates are XOR, AND, INV, EQ (constant), EQW
+// (copy) and MAND (several ANDs). Every input and output value is an array with one element
+// per wire, in wire order
+class BristolCircuit
+{
+ public:
+    // Parse a circuit. MAND gates are split into AND gates
+    static BristolCircuit read(std::istream & stream);
+    static BristolCircuit load(const std::string & path);
+
+    // Number of wires of every input and output value
+    const std::vector<size_t> & input_sizes() const noexcept { return _input_sizes; }
+    const std::vector<size_t> & output_sizes() const noexcept { return _output_sizes; }
+
+    size_t wire_count() const noexcept { return _wire_count; }
+    size_t gate_count() const noexcept { return _gates.size(); }
+
+    // Longest chain of AND gates
+    unsigned int and_depth() const noexcept { return _and_depth; }
+
+    // Number of homomorphic operations per evaluation
+    size_t batch_count() const noexcept { return _batches.size(); }
+
+    // Evaluate gate by gate, for checking
+    std::vector<PlaintextArray> evaluate(const std::vector<PlaintextArray> & inputs) const;
+
+    // Evaluate in layers of equal AND depth. Gates of the same type in a layer are evaluated
+    // by one operation on arrays of their operands
+    std::vector<EncryptedArray> evaluate(const std::vector<EncryptedArray> & inputs) const;
+
+ private:
+    enum class GateType { XOR, AND, INV, EQ, EQW };
+
+    struct Gate
+    {
+        GateType type;
+
+        // Input wires. The constant of EQ gates is the first input
+        size_t a;
+        size_t b;
+
+        size_t output;
+    };
+
+    // Gates evaluated together, and wires not used after them
+    struct Batch
+    {
+        GateType type;
+        std::vector<size_t> gates;
+        std::vector<size_t> released;
+    };
+
+    BristolCircuit() noexcept : _wire_count(0), _and_depth(0) {};
+
+    std::vector<size_t> _input_sizes;
+    std::vector<size_t> _output_sizes;
+    size_t _wire_count;
+
+    std::vector<Gate> _gates;
+    std::vector<Batch> _batches;
+    unsigned int _and_depth;
+
+    // Group gates into batches
+    void plan() noexcept;
+
+    // First output wire
+    size_t output_offset() const noexcept;
+};
+
+} // namespace she
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <cstddef>
-#include <set>
 #include <vector>
 #include <memory>
 
@@ -10,11 +9,14 @@
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/split_free.hpp>
+#include <boost/serialization/version.hpp>
 
 #include <gmpxx.h>
 
+#include "context.hpp"
 #include "key.hpp"
 #include "random.hpp"
+#include "reduction.hpp"
 #include "serializations.hpp"
 
 
@@ -23,6 +25,9 @@ namespace she
 
 class PrivateKey;
 class PlaintextArray;
+class EncryptedArrayStore;
+class RecordSource;
+class PlaintextDatabase;
 
 class EncryptedArray : boost::equality_comparable<EncryptedArray
                      , boost::xorable<EncryptedArray
@@ -35,33 +40,78 @@ class EncryptedArray : boost::equality_comparable<EncryptedArray
  friend class CompressedCiphertext;
  public:
     // Construct empty ciphertext with given public element
-    EncryptedArray(const mpz_class & x, unsigned int max_degree, unsigned int degree=1) noexcept;
+    EncryptedArray(const mpz_class & x, unsigned int max_degree, unsigned int degree=1);
+
+    // Construct empty ciphertext sharing an existing evaluation context
+    EncryptedArray( std::shared_ptr<const EvaluationContext> context
+                  , unsigned int max_degree
+                  , unsigned int degree=1);
 
     // Empty ctor for deserialization purposes
-    EncryptedArray() noexcept {};
+    EncryptedArray() noexcept :
+      _degree(0), _max_degree(0), _noise_bits(0), _noise_limit_bits(0), _lazy_reduction_bits(0) {};
 
     // Homomorphic element-wise addition (XOR)
-    EncryptedArray & operator^=(const PlaintextArray &) noexcept;
-    EncryptedArray & operator^=(const EncryptedArray &) noexcept;
+    EncryptedArray & operator^=(const PlaintextArray &);
+    EncryptedArray & operator^=(const EncryptedArray &);
 
     // Homomorphic element-wise multiplication (AND)
     EncryptedArray & operator&=(const PlaintextArray &) noexcept;
-    EncryptedArray & operator&=(const EncryptedArray &) noexcept;
+    EncryptedArray & operator&=(const EncryptedArray &);
 
     // Homomorphic equality comparison
-    const EncryptedArray equal(const std::vector<PlaintextArray> &) const noexcept;
-    const EncryptedArray equal(const std::vector<EncryptedArray> &) const noexcept;
+    const EncryptedArray equal(const std::vector<PlaintextArray> &) const;
+    const EncryptedArray equal(const std::vector<EncryptedArray> &) const;
 
     // Homomorphic select function
-    const EncryptedArray select(const std::vector<PlaintextArray> &) const noexcept;
-    const EncryptedArray select(const std::vector<EncryptedArray> &) const noexcept;
+    const EncryptedArray select(const std::vector<PlaintextArray> &) const;
+
+    // Select from plaintext arrays with subset sums of `block_bits` consecutive elements of this
+    // precomputed (method of Four Russians). Saves additions for long arrays. Zero picks the
+    // block size from the size of the arrays
+    const EncryptedArray select(const std::vector<PlaintextArray> &, unsigned int block_bits) const;
+    const EncryptedArray select(const std::vector<EncryptedArray> &) const;
+
+    // Homomorphic select over arrays in a mapped store, elements are read in place
+    const EncryptedArray select(const EncryptedArrayStore &) const;
+
+    // Homomorphic select over plaintext records read from the source in one sequential pass
+    const EncryptedArray select(RecordSource &) const;
+
+    // Homomorphic select over a column-major database. Result has the database record size
+    const EncryptedArray select(const PlaintextDatabase &) const;
+
+    // Homomorphic demultiplexer. Treats this as an index (most significant bit first) and returns
+    // the array of all 2^size() comparisons of it with 0, 1, ..., 2^size() - 1
+    const EncryptedArray demux() const;
 
     // Extend array
     EncryptedArray & extend(const EncryptedArray & other) noexcept;
 
-    // Reflects how noisy the ciphertexts, equals the number of homomorphic multiplications performed since encryption
+    // Lazy reduction mode. Sums are reduced modulo public element only when they exceed its size
+    // by more than `headroom_bits`. Zero means every operation is reduced (default)
+    EncryptedArray & set_lazy_reduction(unsigned int headroom_bits) noexcept;
+    unsigned int lazy_reduction() const noexcept { return _lazy_reduction_bits; }
+
+    // Fully reduce all elements modulo public element
+    EncryptedArray & normalize() noexcept;
+
+    // Coarse count of homomorphic multiplications performed since encryption
     unsigned int degree() const noexcept { return _degree; }
 
+    // Upper bound on the noise of every element, in bits. Sums add log2 of the number of terms,
+    // products add up the bounds of the factors, lazy reduction does not change it
+    double noise_bits() const noexcept { return _noise_bits; }
+
+    // Elements decrypt correctly while their noise bound is below this many bits, zero if unknown
+    unsigned int noise_limit() const noexcept { return _noise_limit_bits; }
+
+    // Bits of noise that may still be added, infinite if the limit is unknown
+    double noise_budget() const noexcept;
+
+    // Set noise bound of elements filled in by hand
+    EncryptedArray & set_noise(double noise_bits, unsigned int noise_limit) noexcept;
+
     // Approximate maximum number of homomorphic multiplications
     unsigned int max_degree() const noexcept { return _max_degree; }
 
@@ -75,6 +125,9 @@ class EncryptedArray : boost::equality_comparable<EncryptedArray
     // Public element used in homomorphic operations
     const mpz_class & public_element() const noexcept;
 
+    // Evaluation context of the public element
+    const std::shared_ptr<const EvaluationContext> & context() const noexcept { return _context; }
+
     // Representation comparison (non-homomorphic)
     bool operator==(const EncryptedArray &) const noexcept;
 
@@ -84,11 +137,16 @@ class EncryptedArray : boost::equality_comparable<EncryptedArray
 
     std::vector<mpz_class> _elements;
 
-    void set_public_element(const mpz_class & x) noexcept;
-    static std::set<mpz_class> public_elements;
-    typename std::set<mpz_class>::const_iterator _public_element_ptr;
+    double _noise_bits;
+    unsigned int _noise_limit_bits;
 
-    bool _initialized;
+    unsigned int _lazy_reduction_bits;
+
+    void set_public_element(const mpz_class & x);
+    std::shared_ptr<const EvaluationContext> _context;
+
+    // Reduction context of the public element
+    const ReductionContext & reduction_context() const noexcept;
 
  private:
     friend class boost::serialization::access;
@@ -98,8 +156,20 @@ class EncryptedArray : boost::equality_comparable<EncryptedArray
     {
         ar & BOOST_SERIALIZATION_NVP(_degree);
         ar & BOOST_SERIALIZATION_NVP(_max_degree);
-        ar & BOOST_SERIALIZATION_NVP(_elements);
-        ar & boost::serialization::make_nvp("_public_element", *_public_element_ptr);
+
+        // Lazily reduced elements are normalized before serialization
+        if (_lazy_reduction_bits == 0) {
+            ar & BOOST_SERIALIZATION_NVP(_elements);
+        } else {
+            auto normalized = *this;
+            normalized.normalize();
+            ar & boost::serialization::make_nvp("_elements", normalized._elements);
+        }
+
+        ar & boost::serialization::make_nvp("_public_element", _context->public_element());
+
+        ar & BOOST_SERIALIZATION_NVP(_noise_bits);
+        ar & BOOST_SERIALIZATION_NVP(_noise_limit_bits);
     }
 
     template<class Archive>
@@ -113,6 +183,14 @@ class EncryptedArray : boost::equality_comparable<EncryptedArray
         mpz_class x;
         ar & boost::serialization::make_nvp("_public_element", x);
         set_public_element(x);
+
+        // Archives of version 0 predate noise tracking and leave it unchecked
+        _noise_bits = 0;
+        _noise_limit_bits = 0;
+        if (version >= 1) {
+            ar & BOOST_SERIALIZATION_NVP(_noise_bits);
+            ar & BOOST_SERIALIZATION_NVP(_noise_limit_bits);
+        }
     }
 
     BOOST_SERIALIZATION_SPLIT_MEMBER()
@@ -127,11 +205,17 @@ class CompressedCiphertext : boost::equality_comparable<CompressedCiphertext>
     CompressedCiphertext() noexcept {};
 
     // Expand ciphertext
-    EncryptedArray expand() const noexcept;
+    EncryptedArray expand() const;
+
+    // Expand only the elements with given indexes, in the given order
+    EncryptedArray expand(const std::vector<size_t> & indexes) const;
 
     // Ciphertext size
     size_t size() const noexcept { return _elements_deltas.size(); }
 
+    // Parameters of the key used for encryption
+    const ParameterSet & parameter_set() const noexcept { return _parameter_set; }
+
     // Compressions of encrypted bits
     const std::vector<mpz_class> & elements_deltas() const noexcept { return _elements_deltas; }
     const mpz_class & public_element_delta() const noexcept { return _public_element_delta; }
@@ -147,6 +231,9 @@ class CompressedCiphertext : boost::equality_comparable<CompressedCiphertext>
     void initialize_prf_stream() const noexcept;
     mutable std::unique_ptr<PseudoRandomStream> _prf_stream;
 
+    // Evaluation context of the restored public element, set on first expansion
+    mutable std::shared_ptr<const EvaluationContext> _context;
+
     std::vector<mpz_class> _elements_deltas;
     mpz_class _public_element_delta;
 
@@ -169,6 +256,7 @@ class CompressedCiphertext : boost::equality_comparable<CompressedCiphertext>
         ar & BOOST_SERIALIZATION_NVP(_public_element_delta);
 
         initialize_prf_stream();
+        _context.reset();
     }
 
     BOOST_SERIALIZATION_SPLIT_MEMBER()
@@ -177,15 +265,24 @@ class CompressedCiphertext : boost::equality_comparable<CompressedCiphertext>
 
 // Homomorphic addition (XOR)
 PlaintextArray sum(const std::vector<PlaintextArray> &) noexcept;
-EncryptedArray sum(const std::vector<EncryptedArray> &) noexcept;
+EncryptedArray sum(const std::vector<EncryptedArray> &);
 
 // Homomorphic multiplication (AND)
 PlaintextArray product(const std::vector<PlaintextArray> &) noexcept;
-EncryptedArray product(const std::vector<EncryptedArray> &) noexcept;
+EncryptedArray product(const std::vector<EncryptedArray> &);
 
 // Arrays concatenation
 PlaintextArray concat(const std::vector<PlaintextArray> &) noexcept;
 EncryptedArray concat(const std::vector<EncryptedArray> &) noexcept;
 
+// Hard noise check. When enabled, operations whose result may exceed the noise limit of an
+// operand throw precondition_not_satisfied before changing anything, instead of producing
+// undecryptable elements
+bool noise_check() noexcept;
+void set_noise_check(bool enabled) noexcept;
+
 
 } // namespace she
+
+
+BOOST_CLASS_VERSION(she::EncryptedArray, 1)
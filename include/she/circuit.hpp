@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <boost/operators.hpp>
+
+#include "ciphertext.hpp"
+#include "plaintext.hpp"
+
+
+namespace she
+{
+
+class Circuit;
+
+// Handle to a node of a circuit. Operations on expressions record nodes instead of evaluating them
+class Expression : boost::xorable<Expression
+                 , boost::xorable<Expression, PlaintextArray
+                 , boost::andable<Expression
+                 , boost::andable<Expression, PlaintextArray
+                 > > > >
+{
+ friend class Circuit;
+ public:
+    // Empty ctor, the expression must be assigned before use
+    Expression() noexcept : _circuit(nullptr), _node(0) {};
+
+    // Deferred element-wise addition (XOR)
+    Expression & operator^=(const Expression &);
+    Expression & operator^=(const PlaintextArray &);
+
+    // Deferred element-wise multiplication (AND)
+    Expression & operator&=(const Expression &);
+    Expression & operator&=(const PlaintextArray &);
+
+    // Deferred equality comparison
+    const Expression equal(const std::vector<Expression> &) const;
+
+    // Deferred select function
+    const Expression select(const std::vector<Expression> &) const;
+
+    // Size of the array the expression evaluates to
+    size_t size() const;
+
+    // Circuit and node the expression refers to
+    Circuit * circuit() const noexcept { return _circuit; }
+    size_t node() const noexcept { return _node; }
+
+ private:
+    Expression(Circuit * circuit, size_t node) noexcept : _circuit(circuit), _node(node) {};
+
+    Circuit * _circuit;
+    size_t _node;
+};
+
+
+// Directed acyclic graph of homomorphic operations, evaluated in one pass.
+// Recording an operation reuses an existing node that computes the same thing and folds
+// operations on constants. Before evaluation, chains of multiplications are rebalanced to
+// minimize depth. Operations whose operands are ready run in parallel on the library executor,
+// and intermediate arrays are freed once their last user is done. Expressions refer to the
+// circuit, so it must outlive them
+class Circuit
+{
+ friend class Expression;
+ public:
+    enum class Operation { input, constant, add, multiply, equal, select };
+
+    Circuit() noexcept : _peak_values(0) {};
+
+    Circuit(const Circuit &) = delete;
+    Circuit & operator=(const Circuit &) = delete;
+
+    // Encrypted input. Every call makes a new node
+    Expression input(EncryptedArray array);
+
+    // Known plaintext
+    Expression constant(PlaintextArray array) noexcept;
+
+    // Number of recorded nodes
+    size_t size() const noexcept { return _nodes.size(); }
+
+    // Longest chain of multiplications leading to the expression
+    unsigned int depth(const Expression &) const;
+
+    // Rebalance chains of multiplications that lead to the outputs
+    void optimize(const std::vector<Expression> & outputs);
+
+    // Optimize and evaluate. Constant outputs are trivial encryptions under the context of the
+    // first input
+    EncryptedArray evaluate(const Expression & output);
+    std::vector<EncryptedArray> evaluate(const std::vector<Expression> & outputs);
+
+    // Largest number of intermediate arrays held at once during the last evaluation
+    size_t peak_values() const noexcept { return _peak_values; }
+
+ private:
+    struct Node
+    {
+        Operation operation;
+        std::vector<size_t> operands;
+
+        // Size of the array the node evaluates to
+        size_t size;
+
+        // Longest chain of multiplications leading to the node
+        unsigned int depth;
+
+        // Inputs and constants
+        std::shared_ptr<const EncryptedArray> input;
+        std::shared_ptr<const PlaintextArray> constant;
+    };
+
+    std::vector<Node> _nodes;
+    size_t _peak_values;
+
+    // Nodes by operation and operands, and constants by size and bits, for sharing common subexpressions
+    std::map<std::pair<Operation, std::vector<size_t>>, size_t> _index;
+    std::map<std::pair<size_t, std::vector<PlaintextArray::word_t>>, size_t> _constants;
+
+    // Record an operation, reusing or folding it where possible
+    size_t record(Operation operation, std::vector<size_t> operands) noexcept;
+    size_t record_constant(PlaintextArray array) noexcept;
+
+    // Constant value of the node, or null
+    const PlaintextArray * constant_value(size_t node) const noexcept;
+
+    // Size and depth of the result of an operation
+    size_t result_size(Operation operation, const std::vector<size_t> & operands) const noexcept;
+    unsigned int result_depth(Operation operation, const std::vector<size_t> & operands) const noexcept;
+
+    // Reachable nodes in evaluation order, operands first
+    std::vector<size_t> schedule(const std::vector<Expression> & outputs) const;
+
+    // Number of references to every node from reachable nodes and outputs
+    std::vector<size_t> references(const std::vector<size_t> & order, const std::vector<Expression> & outputs) const noexcept;
+
+    Expression expression(size_t node) noexcept { return Expression(this, node); }
+};
+
+} // namespace she
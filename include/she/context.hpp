@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+
+#include <gmpxx.h>
+
+#include "reduction.hpp"
+
+
+namespace she
+{
+
+// Public element of encrypted arrays together with the data precomputed for evaluation
+// modulo it. Arrays under the same public element share one context
+class EvaluationContext
+{
+ public:
+    EvaluationContext(const mpz_class & public_element);
+
+    // Shared context of the public element. A context is freed once no array uses it
+    static std::shared_ptr<const EvaluationContext> get(const mpz_class & public_element);
+
+    const mpz_class & public_element() const noexcept { return _reduction.modulus(); }
+    const ReductionContext & reduction() const noexcept { return _reduction; }
+
+ private:
+    ReductionContext _reduction;
+};
+
+} // namespace she
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "plaintext.hpp"
+
+
+namespace she
+{
+
+// Plaintext records read one after another, for databases that do not fit in memory
+class RecordSource
+{
+ public:
+    virtual ~RecordSource() noexcept {}
+
+    // Read the next record. Returns false once there are no more records
+    virtual bool next(PlaintextArray & record) = 0;
+};
+
+
+// Records held in memory
+class VectorRecordSource : public RecordSource
+{
+ public:
+    VectorRecordSource(const std::vector<PlaintextArray> & records) noexcept :
+      _records(records), _position(0) {}
+
+    bool next(PlaintextArray & record) override;
+
+ private:
+    const std::vector<PlaintextArray> & _records;
+    size_t _position;
+};
+
+
+// Memory-mapped file of bit-packed records of equal size. Bits of every record are packed
+// least significant bit first and the record is padded to whole bytes
+class PackedRecordFile : public RecordSource
+{
+ public:
+    struct Header
+    {
+        char magic[8];
+        uint64_t count;
+        uint64_t record_size;
+    };
+
+    // Write all records of the source, padding them with zeros to `record_size` bits
+    static void write(const std::string & path, RecordSource & records, size_t record_size);
+
+    // Map an existing file. Records are read from the first one
+    PackedRecordFile(const std::string & path);
+    ~PackedRecordFile() noexcept;
+
+    PackedRecordFile(const PackedRecordFile &) = delete;
+    PackedRecordFile & operator=(const PackedRecordFile &) = delete;
+
+    bool next(PlaintextArray & record) override;
+
+    // Start over from the first record
+    void rewind() noexcept { _position = 0; }
+
+    // Number of records and their size in bits
+    size_t size() const noexcept { return _header.count; }
+    size_t record_size() const noexcept { return _header.record_size; }
+
+ private:
+    Header _header;
+    void * _mapping;
+    size_t _mapping_size;
+    const unsigned char * _records;
+    size_t _position;
+};
+
+
+// Plaintext database stored column by column. Column j packs bit j of every record into
+// 64-bit words, record i at bit i % 64 of word i / 64. Shorter records are padded with zeros
+class PlaintextDatabase
+{
+ public:
+    using word_t = uint64_t;
+
+    // Transpose records
+    PlaintextDatabase(const std::vector<PlaintextArray> & records);
+    PlaintextDatabase(RecordSource & records);
+
+    // Number of records and size of the longest one
+    size_t size() const noexcept { return _size; }
+    size_t record_size() const noexcept { return _columns.size(); }
+
+    // Packed column number `index`, of column_words() words
+    const word_t * column(size_t index) const noexcept { return _columns[index].data(); }
+    size_t column_words() const noexcept { return (_size + 63) / 64; }
+
+    // Record number `index`, padded to the record size
+    PlaintextArray record(size_t index) const;
+
+ private:
+    void append(RecordSource & records);
+
+    size_t _size;
+    std::vector<std::vector<word_t>> _columns;
+};
+
+} // namespace she
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 
@@ -9,4 +10,7 @@ namespace she
 const unsigned int INTEGER_SERIALIZATION_BASE = 62;
 const std::string RANDOM_DEVICE = "/dev/urandom";
 
+// Default memory budget of the pseudo-random value cache
+const size_t PRF_CACHE_CAPACITY = 256 << 20;
+
 } // namespace she
@@ -8,6 +8,7 @@
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 
 #include <gmpxx.h>
 
@@ -25,7 +26,8 @@ public:
                  unsigned int noise_size_bits,
                  unsigned int private_key_size_bits,
                  unsigned int ciphertext_size_bits,
-                 unsigned int prf_seed);
+                 unsigned int prf_seed,
+                 PRFMode prf_mode = PRFMode::stream);
 
     ParameterSet() noexcept;
 
@@ -34,15 +36,23 @@ public:
     unsigned int private_key_size_bits;
     unsigned int ciphertext_size_bits;
     unsigned int prf_seed;
+    PRFMode prf_mode;
 
     // Generate parameter set for given `security`, random prf `seed`, that allows to perform at least
     // `circuit_mult_size homomorphic multiplications on ciphertexts
     static const ParameterSet
-    generate_parameter_set(unsigned int security, unsigned int circuit_mult_size, unsigned int seed);
+    generate_parameter_set(unsigned int security, unsigned int circuit_mult_size, unsigned int seed,
+                           PRFMode prf_mode = PRFMode::stream);
 
     // Approximate number of homomorphic multiplications that can be performed
     unsigned int degree() const noexcept { return private_key_size_bits / noise_size_bits; }
 
+    // Upper bound on the noise of freshly encrypted elements, in bits
+    double fresh_noise_bits() const noexcept;
+
+    // Elements decrypt correctly while their noise stays below this many bits
+    unsigned int noise_limit_bits() const noexcept { return private_key_size_bits - 1; }
+
     bool operator==(const ParameterSet &) const noexcept;
 
  private:
@@ -56,6 +66,14 @@ public:
         ar & BOOST_SERIALIZATION_NVP(private_key_size_bits);
         ar & BOOST_SERIALIZATION_NVP(ciphertext_size_bits);
         ar & BOOST_SERIALIZATION_NVP(prf_seed);
+
+        // Archives of version 0 predate counter mode and always use stream mode
+        unsigned int mode = static_cast<unsigned int>(PRFMode::stream);
+        if (version >= 1) {
+            mode = static_cast<unsigned int>(prf_mode);
+            ar & boost::serialization::make_nvp("prf_mode", mode);
+        }
+        prf_mode = static_cast<PRFMode>(mode);
     }
 };
 
@@ -117,3 +135,6 @@ class PrivateKey : boost::equality_comparable<PrivateKey>
 
 
 } // namespace she
+
+
+BOOST_CLASS_VERSION(she::ParameterSet, 1)
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace she
+{
+
+// Loop body over the index range [begin, end)
+using LoopBody = std::function<void(size_t begin, size_t end)>;
+
+// Task body, called with the number of the task
+using TaskBody = std::function<void(size_t task)>;
+
+// Tasks with dependencies. A task is ready once every task it depends on has finished
+struct TaskGraph
+{
+    // Tasks that depend on the i-th task, a task listed twice depends on it twice
+    std::vector<std::vector<size_t>> successors;
+
+    // Number of dependencies of the i-th task
+    std::vector<size_t> dependencies;
+
+    size_t size() const noexcept { return dependencies.size(); }
+};
+
+
+// Runs loop bodies over disjoint index ranges
+class Executor
+{
+ public:
+    virtual ~Executor() noexcept {}
+
+    // Call `body` on disjoint ranges covering [0, size) and wait for all of them to finish
+    virtual void parallel_for(size_t size, const LoopBody & body) = 0;
+
+    // Number of threads that execute loop bodies
+    virtual size_t concurrency() const noexcept = 0;
+
+    // Call `body` on every task of the graph once its dependencies have finished, and wait for
+    // all of them to finish. By default ready tasks run in waves, one `parallel_for` per wave
+    virtual void run(const TaskGraph & graph, const TaskBody & body);
+};
+
+
+// Runs loop bodies on the calling thread
+class SerialExecutor : public Executor
+{
+ public:
+    void parallel_for(size_t size, const LoopBody & body) override;
+    size_t concurrency() const noexcept override { return 1; }
+
+    // Newest ready task first, so results are used soon after they are computed
+    void run(const TaskGraph & graph, const TaskBody & body) override;
+};
+
+
+// Fixed-size pool of worker threads. The calling thread takes part in the work
+class ThreadPool : public Executor
+{
+ public:
+    // Zero threads means one per hardware thread
+    ThreadPool(size_t threads = 0);
+    ~ThreadPool() noexcept;
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    void parallel_for(size_t size, const LoopBody & body) override;
+    size_t concurrency() const noexcept override { return _workers.size() + 1; }
+
+ private:
+    void work() noexcept;
+    bool run_pending_task(std::unique_lock<std::mutex> & lock) noexcept;
+
+    std::vector<std::thread> _workers;
+    std::deque<std::function<void()>> _tasks;
+
+    std::mutex _mutex;
+    std::condition_variable _task_available;
+    std::condition_variable _task_finished;
+    bool _stopping;
+};
+
+
+// Pool of worker threads with a task queue each. Threads take tasks they queued themselves
+// newest first and steal the oldest tasks of other threads when their own queue runs dry.
+// Loops and task graphs started from a task queue their work on the same pool, and the
+// waiting thread keeps running tasks meanwhile. The calling thread takes part in the work
+class WorkStealingPool : public Executor
+{
+ public:
+    // Zero threads means one per hardware thread
+    WorkStealingPool(size_t threads = 0);
+    ~WorkStealingPool() noexcept;
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool & operator=(const WorkStealingPool &) = delete;
+
+    void parallel_for(size_t size, const LoopBody & body) override;
+    size_t concurrency() const noexcept override { return _queues.size(); }
+
+    // Ready tasks start as soon as their last dependency finishes, without waiting for a wave
+    void run(const TaskGraph & graph, const TaskBody & body) override;
+
+ private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void work(size_t index) noexcept;
+
+    // Queue of the calling thread. Threads outside the pool share the first queue
+    size_t current_queue() const noexcept;
+
+    void push(size_t queue, std::function<void()> task);
+    bool run_pending_task(size_t queue) noexcept;
+
+    // Run tasks until `done` holds
+    void wait_until(size_t queue, const std::function<bool()> & done) noexcept;
+    void notify() noexcept;
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    std::atomic<size_t> _pending;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    bool _stopping;
+};
+
+
+// Executor used by homomorphic operations. Serial by default
+std::shared_ptr<Executor> executor() noexcept;
+void set_executor(std::shared_ptr<Executor> executor) noexcept;
+
+// Loops over fewer items than the threshold run serially
+size_t parallel_threshold() noexcept;
+void set_parallel_threshold(size_t threshold) noexcept;
+
+// Run `body` over [0, size) on the library executor. Short loops, and loops nested in
+// a parallel loop body, run serially on the calling thread
+void parallel_for(size_t size, const LoopBody & body);
+
+// Run the task graph on the library executor. Graphs nested in a parallel loop body run
+// serially on the calling thread
+void run(const TaskGraph & graph, const TaskBody & body);
+
+} // namespace she
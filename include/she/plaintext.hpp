@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 
 #include <boost/operators.hpp>
@@ -8,6 +9,8 @@
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/split_free.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
 
 #include "serializations.hpp"
 
@@ -17,6 +20,8 @@ namespace she
 
 class EncryptedArray;
 
+// Bits packed into 64-bit words, element i at bit i % 64 of word i / 64. Bits of the last word
+// past the size are always zero
 class PlaintextArray : boost::equality_comparable<PlaintextArray
                      , boost::xorable<PlaintextArray
                      , boost::andable<PlaintextArray
@@ -24,15 +29,19 @@ class PlaintextArray : boost::equality_comparable<PlaintextArray
 {
  friend class EncryptedArray;
  public:
+    using word_t = uint64_t;
+
     // Construct from plaintext
-    PlaintextArray(const std::vector<bool> & plaintext) noexcept : _elements(plaintext) {}
+    PlaintextArray(const std::vector<bool> & plaintext) noexcept;
+
+    // Construct from packed words. Bits past `size` are ignored
+    PlaintextArray(std::vector<word_t> words, size_t size) noexcept;
 
     // Empty ctor for deserialization purposes
-    PlaintextArray() noexcept {};
+    PlaintextArray() noexcept : _size(0) {};
 
-    // Convert to bits
-    operator const std::vector<bool>() const { return _elements; };
-    operator std::vector<bool>() { return _elements; };
+    // Convert to bits. Copies the array
+    operator std::vector<bool>() const { return elements(); };
 
     // Element-wise addition (XOR)
     PlaintextArray & operator^=(const PlaintextArray &) noexcept;
@@ -42,11 +51,14 @@ class PlaintextArray : boost::equality_comparable<PlaintextArray
 
     // Homomorphic equality comparison
     const PlaintextArray equal(const std::vector<PlaintextArray> &) const noexcept;
-    const EncryptedArray equal(const std::vector<EncryptedArray> &) const noexcept;
+    const EncryptedArray equal(const std::vector<EncryptedArray> &) const;
 
     // Homomorphic select function
     const PlaintextArray select(const std::vector<PlaintextArray> &) const noexcept;
-    const EncryptedArray select(const std::vector<EncryptedArray> &) const noexcept;
+    const EncryptedArray select(const std::vector<EncryptedArray> &) const;
+
+    // Homomorphic demultiplexer
+    const PlaintextArray demux() const noexcept;
 
     // Extend array
     PlaintextArray & extend(const PlaintextArray & other) noexcept;
@@ -56,11 +68,27 @@ class PlaintextArray : boost::equality_comparable<PlaintextArray
     unsigned int max_degree() const noexcept { return 0; }
 
     // Ciphertext size
-    size_t size() const noexcept { return _elements.size(); }
+    size_t size() const noexcept { return _size; }
+
+    // Change size, padding with zeros from the right
+    PlaintextArray & resize(size_t size) noexcept;
+
+    // Single bits
+    bool operator[](size_t index) const noexcept { return (_words[index / 64] >> (index % 64)) & 1; }
+    void set(size_t index, bool value) noexcept
+    {
+        const word_t mask = word_t(1) << (index % 64);
+        _words[index / 64] = value ? (_words[index / 64] | mask) : (_words[index / 64] & ~mask);
+    }
+
+    // Packed words, without copying. Bits past the size must stay zero
+    const word_t * words() const noexcept { return _words.data(); }
+    word_t * words() noexcept { return _words.data(); }
+    size_t word_count() const noexcept { return _words.size(); }
 
-    // Encrypted bits
-    const std::vector<bool>& elements() const noexcept { return _elements; }
-    std::vector<bool>& elements() noexcept { return _elements; }
+    // Unpacked bits. Copies the array. There is no mutable reference to the bits any more, since
+    // they are packed. Use set(), resize() or words() to change them
+    std::vector<bool> elements() const noexcept;
 
     // Representation comparison
     bool operator==(const PlaintextArray &) const noexcept;
@@ -68,13 +96,38 @@ class PlaintextArray : boost::equality_comparable<PlaintextArray
  private:
     friend class boost::serialization::access;
 
-    std::vector<bool> _elements;
+    size_t _size;
+    std::vector<word_t> _words;
 
     template<class Archive>
-    void serialize(Archive & ar, unsigned int const version) const
+    void save(Archive & ar, unsigned int const version) const
     {
-        ar & BOOST_SERIALIZATION_NVP(_elements);
+        ar & BOOST_SERIALIZATION_NVP(_size);
+        ar & BOOST_SERIALIZATION_NVP(_words);
     }
+
+    template<class Archive>
+    void load(Archive & ar, unsigned int const version)
+    {
+        // Archives of version 0 store unpacked bits
+        if (version == 0) {
+            std::vector<bool> elements;
+            ar & boost::serialization::make_nvp("_elements", elements);
+            *this = PlaintextArray(elements);
+            return;
+        }
+
+        size_t size = 0;
+        std::vector<word_t> words;
+        ar & boost::serialization::make_nvp("_size", size);
+        ar & boost::serialization::make_nvp("_words", words);
+        *this = PlaintextArray(std::move(words), size);
+    }
+
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
 
-} // namespace she
\ No newline at end of file
+} // namespace she
+
+
+BOOST_CLASS_VERSION(she::PlaintextArray, 1)
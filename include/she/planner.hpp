@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+
+#include "key.hpp"
+#include "random.hpp"
+
+
+namespace she
+{
+
+// Shape of a circuit, as far as noise growth is concerned
+struct CircuitShape
+{
+    // Longest chain of multiplications from an input to an output
+    unsigned int depth;
+
+    // Operands of a multiplication
+    unsigned int fan_in;
+
+    // Largest number of additions applied to a value before it is multiplied or output,
+    // additions of plaintext ones included
+    unsigned int additions;
+};
+
+
+// Parameters planned for a circuit, and what they cost
+struct ParameterPlan
+{
+    ParameterSet parameter_set;
+
+    // Upper bound on the noise of an output element, in bits
+    unsigned int noise_bits;
+
+    // Size of one encrypted element, expanded and compressed
+    size_t ciphertext_bytes;
+    size_t compressed_bytes;
+
+    // Estimated 64-bit word operations of an addition, and of a multiplication with Barrett
+    // reduction (three Karatsuba products), of two elements
+    double addition_cost;
+    double multiplication_cost;
+};
+
+
+// Smallest parameters for given `security` that decrypt the outputs of any circuit of the
+// given shape correctly:
+//  - noise size is 2 * security, against the square-root attack of Chen and Nguyen
+//  - private key size exceeds the output noise, and the elliptic curve method takes at least
+//    2^security steps to find the private key in the public element
+//  - ciphertext size is private key size squared times log2(security), the lattice bound of [DGHV10]
+ParameterPlan plan_parameters(unsigned int security, const CircuitShape & shape, unsigned int seed,
+                              PRFMode prf_mode = PRFMode::stream);
+
+} // namespace she
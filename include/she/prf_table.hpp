@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <gmpxx.h>
+
+#include "she/random.hpp"
+
+
+namespace she
+{
+
+// Precomputed pseudo-random values stored on disk and mapped read-only, so that several
+// processes share one copy in the page cache.
+//
+// File layout, in native byte order: a fixed header followed by `count` values, each
+// stored as `stride` limbs, least significant limb first and padded with zero limbs
+class PRFTable
+{
+ public:
+    struct Header
+    {
+        char magic[8];
+        uint32_t byte_order;
+        uint32_t limb_bytes;
+        uint32_t size;
+        uint32_t seed;
+        uint32_t mode;
+        uint32_t reserved;
+        uint64_t count;
+        uint64_t stride;
+    };
+
+    // Precompute the first `count` values of the stream (size, seed, mode) into `path`
+    static void write( const std::string & path
+                     , unsigned int size
+                     , unsigned int seed
+                     , PRFMode mode
+                     , size_t count);
+
+    // Map an existing table
+    PRFTable(const std::string & path);
+    ~PRFTable() noexcept;
+
+    PRFTable(const PRFTable &) = delete;
+    PRFTable & operator=(const PRFTable &) = delete;
+
+    unsigned int size() const noexcept { return _header.size; }
+    unsigned int seed() const noexcept { return _header.seed; }
+    PRFMode mode() const noexcept { return static_cast<PRFMode>(_header.mode); }
+    size_t count() const noexcept { return _header.count; }
+
+    // Value number `index`, copied out of the mapping
+    mpz_class operator[](size_t index) const;
+
+    // Value number `index` without copying. `storage` only holds the view and must outlive it
+    mpz_srcptr view(size_t index, mpz_ptr storage) const;
+
+ private:
+    Header _header;
+    void * _mapping;
+    size_t _mapping_size;
+    const mp_limb_t * _limbs;
+};
+
+} // namespace she
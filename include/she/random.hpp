@@ -1,9 +1,15 @@
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 #include <vector>
 #include <utility>
-#include <map>
 
 #include <gmpxx.h>
 
@@ -25,26 +31,128 @@ class CSPRNG
 };
 
 
+// How pseudo-random values for ciphertext compression are produced
+enum class PRFMode : unsigned int
+{
+    // Sequential output of a seeded GMP generator (compatibility mode)
+    stream = 0,
+
+    // ChaCha20 in counter mode, every value is computed directly from (seed, index)
+    counter = 1,
+};
+
+
+// Counter-mode pseudo-random function based on ChaCha20. Produces `size`-bit values
+class PseudoRandomFunction
+{
+ public:
+    PseudoRandomFunction(unsigned int size, unsigned int seed) noexcept;
+
+    // Value number `index`
+    mpz_class operator()(size_t index) const noexcept;
+
+ private:
+    unsigned int _size;
+    std::array<uint32_t, 8> _key;
+};
+
+
+// Thread-safe cache of pseudo-random values, bounded by a byte budget. The least recently
+// used values are evicted first. With zero capacity nothing is stored and values are
+// recomputed on every request
+class PRFCache
+{
+ public:
+    // (mode, size, seed, index)
+    using key_t = std::tuple<PRFMode, unsigned int, unsigned int, size_t>;
+    using value_t = std::shared_ptr<const mpz_class>;
+
+    struct Statistics
+    {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t entries;
+        size_t bytes;
+    };
+
+    PRFCache(size_t capacity_bytes) noexcept;
+
+    PRFCache(const PRFCache &) = delete;
+    PRFCache & operator=(const PRFCache &) = delete;
+
+    // Cached value, or nullptr on a miss
+    value_t find(const key_t & key) noexcept;
+    void insert(const key_t & key, const value_t & value) noexcept;
+
+    // Shrinking the budget evicts values right away
+    size_t capacity() const noexcept;
+    void set_capacity(size_t capacity_bytes) noexcept;
+
+    Statistics statistics() const noexcept;
+    void reset_statistics() noexcept;
+
+    void clear() noexcept;
+
+ private:
+    using entries_t = std::list<std::pair<key_t, value_t>>;
+
+    static size_t footprint(const mpz_class & value) noexcept;
+    void evict(size_t capacity_bytes) noexcept;
+
+    mutable std::mutex _mutex;
+    size_t _capacity;
+
+    // Most recently used entries first
+    entries_t _entries;
+    std::map<key_t, entries_t::iterator> _index;
+
+    Statistics _statistics;
+};
+
+
+class PRFTable;
+
+
 class PseudoRandomStream
 {
  public:
-    PseudoRandomStream(unsigned int size, unsigned int seed);
+    PseudoRandomStream(unsigned int size, unsigned int seed, PRFMode mode = PRFMode::stream);
 
+    // Returned reference stays valid until the next call to `next`
     const mpz_class & next() const noexcept;
     const void reset() const noexcept;
-    static void reset_cache() noexcept { cached_values.clear(); }
+
+    // Cache shared by all streams
+    static PRFCache & cache() noexcept;
+    static void reset_cache() noexcept { cache().clear(); }
+
+    // Serve values from a precomputed table instead of the cache. Applies to streams
+    // with the table's size, seed and mode that are created after attaching it
+    static void attach_table(std::shared_ptr<const PRFTable> table) noexcept;
+    static void detach_tables() noexcept;
+
+    // Whether values can be accessed out of order (and from several threads) with `at`
+    bool random_access() const noexcept { return _mode == PRFMode::counter; }
+
+    // Value number `index`, available only in random access mode
+    mpz_class at(size_t index) const;
 
  private:
+    PRFCache::value_t value(size_t index) const noexcept;
+
     unsigned int _size;
     unsigned int _seed;
+    PRFMode _mode;
     mutable gmp_randclass _generator;
+    PseudoRandomFunction _function;
+    std::shared_ptr<const PRFTable> _table;
 
-    mutable size_t _current_value;
+    // Index of the value the generator produces next (stream mode)
+    mutable size_t _generator_position;
 
-    using keys_t = std::pair<unsigned int, unsigned int>;
-    using values_t = std::vector<mpz_class>;
-
-    static std::map<keys_t, values_t> cached_values;
+    mutable size_t _current_value;
+    mutable PRFCache::value_t _value;
 };
 
 } // namespace she
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+#include <gmpxx.h>
+
+
+namespace she
+{
+
+// Precomputed data for repeated reduction modulo a fixed modulus (Barrett reduction)
+class ReductionContext
+{
+ public:
+    ReductionContext(const mpz_class & modulus);
+
+    // Reduce value modulo the modulus in place. Gives the same result as `value %= modulus()`
+    void reduce(mpz_class & value) const noexcept;
+
+    // Lazy reduction: reduce value only if it exceeds the modulus size by more than `headroom_bits`
+    void reduce(mpz_class & value, unsigned int headroom_bits) const noexcept;
+
+    // Modular multiplication of value by other in place. Operands need not be reduced
+    void multiply(mpz_class & value, const mpz_class & other) const noexcept;
+
+    // Modulus and its size in bits
+    const mpz_class & modulus() const noexcept { return _modulus; }
+    size_t modulus_bits() const noexcept { return _modulus_bits; }
+
+ private:
+    mpz_class _modulus;
+    size_t _modulus_bits;
+
+    // Scaled reciprocal of the modulus, floor(2^(2 * modulus_bits) / modulus)
+    mpz_class _reciprocal;
+};
+
+} // namespace she
@@ -1,33 +1,156 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include <boost/serialization/nvp.hpp>
+#include <boost/serialization/binary_object.hpp>
 #include <boost/serialization/split_free.hpp>
+#include <boost/serialization/version.hpp>
 
 #include <gmpxx.h>
 
 #include "defs.hpp"
 
 
-namespace boost { namespace serialization {
+namespace boost { namespace archive {
+
+class binary_oarchive;
+class binary_iarchive;
+
+}} // namespace boost::archive
+
+
+namespace she
+{
+
+// How integers are written to an archive
+enum class IntegerEncoding
+{
+    // Base-62 string, readable and portable (text and XML archives)
+    base62,
+
+    // Magnitude as little-endian bytes
+    binary,
+};
+
+// Encoding of integers per archive type. Specialize to choose the encoding for other archives
+template <class Archive>
+struct integer_encoding
+    : std::integral_constant<IntegerEncoding, IntegerEncoding::base62> {};
+
+template <>
+struct integer_encoding<boost::archive::binary_oarchive>
+    : std::integral_constant<IntegerEncoding, IntegerEncoding::binary> {};
+
+template <>
+struct integer_encoding<boost::archive::binary_iarchive>
+    : std::integral_constant<IntegerEncoding, IntegerEncoding::binary> {};
+
+namespace detail
+{
+
+template <IntegerEncoding encoding>
+using integer_encoding_tag = std::integral_constant<IntegerEncoding, encoding>;
+
+// Magnitude of `value` as little-endian bytes, empty for zero
+inline std::vector<unsigned char> export_magnitude(const mpz_class & value)
+{
+    std::vector<unsigned char> bytes((mpz_sizeinbase(value.get_mpz_t(), 2) + 7) / 8);
+    size_t written = 0;
+    mpz_export(bytes.data(), &written, -1, 1, 0, 0, value.get_mpz_t());
+    bytes.resize(written);
+    return bytes;
+}
+
+// Integer of given sign and little-endian magnitude
+inline void import_magnitude(mpz_class & value, const unsigned char * bytes, size_t size, bool negative)
+{
+    mpz_import(value.get_mpz_t(), size, -1, 1, 0, 0, bytes);
+    if (negative) {
+        value = -value;
+    }
+}
 
 template<class Archive>
-void save(Archive & ar, const mpz_class & value, const unsigned int version)
+void save_integer( Archive & ar
+                 , const mpz_class & value
+                 , integer_encoding_tag<IntegerEncoding::base62>)
 {
-    std::string repr = value.get_str(she::INTEGER_SERIALIZATION_BASE);
+    std::string repr = value.get_str(INTEGER_SERIALIZATION_BASE);
     ar & BOOST_SERIALIZATION_NVP(repr);
 }
 
 template<class Archive>
-void load(Archive & ar, mpz_class & value, const unsigned int version)
+void load_integer( Archive & ar
+                 , mpz_class & value
+                 , integer_encoding_tag<IntegerEncoding::base62>)
 {
     std::string repr;
     ar & BOOST_SERIALIZATION_NVP(repr);
-    value.set_str(repr, she::INTEGER_SERIALIZATION_BASE);
+    value.set_str(repr, INTEGER_SERIALIZATION_BASE);
+}
+
+template<class Archive>
+void save_integer( Archive & ar
+                 , const mpz_class & value
+                 , integer_encoding_tag<IntegerEncoding::binary>)
+{
+    int sign = mpz_sgn(value.get_mpz_t());
+    auto bytes = export_magnitude(value);
+    uint64_t size = bytes.size();
+
+    ar & BOOST_SERIALIZATION_NVP(sign);
+    ar & BOOST_SERIALIZATION_NVP(size);
+    ar & boost::serialization::make_nvp("bytes",
+        boost::serialization::make_binary_object(bytes.data(), size));
+}
+
+template<class Archive>
+void load_integer( Archive & ar
+                 , mpz_class & value
+                 , integer_encoding_tag<IntegerEncoding::binary>)
+{
+    int sign;
+    uint64_t size;
+    ar & BOOST_SERIALIZATION_NVP(sign);
+    ar & BOOST_SERIALIZATION_NVP(size);
+
+    std::vector<unsigned char> bytes(size);
+    ar & boost::serialization::make_nvp("bytes",
+        boost::serialization::make_binary_object(bytes.data(), size));
+
+    import_magnitude(value, bytes.data(), size, sign < 0);
+}
+
+} // namespace detail
+
+} // namespace she
+
+
+namespace boost { namespace serialization {
+
+template<class Archive>
+void save(Archive & ar, const mpz_class & value, const unsigned int version)
+{
+    she::detail::save_integer(ar, value, she::integer_encoding<Archive>());
+}
+
+template<class Archive>
+void load(Archive & ar, mpz_class & value, const unsigned int version)
+{
+    // Version 0 archives store base-62 strings regardless of the archive type
+    if (version == 0) {
+        she::detail::load_integer(ar, value, she::detail::integer_encoding_tag<she::IntegerEncoding::base62>());
+    } else {
+        she::detail::load_integer(ar, value, she::integer_encoding<Archive>());
+    }
 }
 
 }} // namespace boost::serialization
 
 BOOST_SERIALIZATION_SPLIT_FREE(mpz_class)
+BOOST_CLASS_VERSION(mpz_class, 1)
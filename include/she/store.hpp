@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmpxx.h>
+
+#include "ciphertext.hpp"
+#include "context.hpp"
+
+
+namespace she
+{
+
+// On-disk file of encrypted arrays under one public element. Elements are stored reduced,
+// as fixed-stride limbs in native byte order, so they can be used straight from a read-only
+// mapping.
+//
+// File layout: header, public element, elements of all arrays one after another, and a
+// table with the position, size, degree and noise bound of every array
+class EncryptedArrayStore
+{
+ public:
+    struct Header
+    {
+        char magic[8];
+        uint32_t byte_order;
+        uint32_t limb_bytes;
+        uint64_t stride;
+        uint64_t count;
+        uint64_t table_offset;
+        uint32_t max_degree;
+        uint32_t noise_limit;
+    };
+
+    struct Record
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t degree;
+        uint32_t noise_bits;
+    };
+
+    // Appends arrays to a new store one at a time
+    class Writer
+    {
+     public:
+        Writer(const std::string & path, std::shared_ptr<const EvaluationContext> context,
+               unsigned int max_degree);
+        ~Writer() noexcept;
+
+        Writer(const Writer &) = delete;
+        Writer & operator=(const Writer &) = delete;
+
+        // Array must have the store's public element
+        void append(const EncryptedArray & array);
+
+        // Write the array table. Called by the destructor if needed
+        void close();
+
+     private:
+        std::ofstream _file;
+        std::string _path;
+        std::shared_ptr<const EvaluationContext> _context;
+        Header _header;
+        std::vector<Record> _records;
+        uint64_t _elements;
+        bool _closed;
+    };
+
+    // Read-only view of a stored array, elements are read from the mapping
+    class View
+    {
+     public:
+        size_t size() const noexcept { return _record->size; }
+        unsigned int degree() const noexcept { return _record->degree; }
+
+        // Noise bound rounded up to whole bits, zero in stores written without noise tracking
+        unsigned int noise_bits() const noexcept { return _record->noise_bits; }
+
+        // Element number `index`. `storage` only holds the view and must outlive it
+        mpz_srcptr element(size_t index, mpz_ptr storage) const;
+
+        // Copy the array into memory
+        EncryptedArray load() const noexcept;
+
+     private:
+        friend class EncryptedArrayStore;
+        View(const EncryptedArrayStore & store, const Record & record) noexcept :
+          _store(&store), _record(&record) {}
+
+        const EncryptedArrayStore * _store;
+        const Record * _record;
+    };
+
+    // Write all arrays to a new store
+    static void write(const std::string & path, const std::vector<EncryptedArray> & arrays);
+
+    // Map an existing store
+    EncryptedArrayStore(const std::string & path);
+    ~EncryptedArrayStore() noexcept;
+
+    EncryptedArrayStore(const EncryptedArrayStore &) = delete;
+    EncryptedArrayStore & operator=(const EncryptedArrayStore &) = delete;
+
+    // Number of stored arrays
+    size_t size() const noexcept { return _header.count; }
+
+    View operator[](size_t index) const;
+
+    unsigned int max_degree() const noexcept { return _header.max_degree; }
+    unsigned int noise_limit() const noexcept { return _header.noise_limit; }
+    const mpz_class & public_element() const noexcept { return _context->public_element(); }
+    const std::shared_ptr<const EvaluationContext> & context() const noexcept { return _context; }
+
+ private:
+    Header _header;
+    void * _mapping;
+    size_t _mapping_size;
+    const mp_limb_t * _elements;
+    const Record * _records;
+    std::shared_ptr<const EvaluationContext> _context;
+};
+
+} // namespace she
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+
+#include <gmpxx.h>
+
+#include "ciphertext.hpp"
+#include "context.hpp"
+#include "key.hpp"
+#include "random.hpp"
+
+
+namespace she
+{
+
+// Incremental binary format for sending arrays over a connection. A short header with the
+// array metadata is followed by the elements, which are written and read one at a time.
+// Integers are stored as sign, byte length and little-endian magnitude. Readers reject integers
+// longer than the public element allows and do not trust sizes in the header for allocation
+
+
+// Writes an encrypted array element by element
+class EncryptedArrayWriter
+{
+ public:
+    // Write the header of an array with `size` elements
+    EncryptedArrayWriter( std::ostream & output
+                        , std::shared_ptr<const EvaluationContext> context
+                        , size_t size
+                        , unsigned int max_degree
+                        , unsigned int degree=1
+                        , double noise_bits=0
+                        , unsigned int noise_limit=0);
+
+    // Write the header and then all elements of the array
+    EncryptedArrayWriter(std::ostream & output, const EncryptedArray & array);
+
+    // Write the next element. Lazily reduced elements are reduced
+    void write(const mpz_class & element);
+
+    // Number of elements still expected
+    size_t remaining() const noexcept { return _remaining; }
+
+ private:
+    std::ostream & _output;
+    std::shared_ptr<const EvaluationContext> _context;
+    size_t _remaining;
+};
+
+
+// Reads an encrypted array element by element
+class EncryptedArrayReader
+{
+ public:
+    // Read the header
+    EncryptedArrayReader(std::istream & input);
+
+    size_t size() const noexcept { return _size; }
+    size_t remaining() const noexcept { return _remaining; }
+    unsigned int degree() const noexcept { return _degree; }
+    unsigned int max_degree() const noexcept { return _max_degree; }
+    const std::shared_ptr<const EvaluationContext> & context() const noexcept { return _context; }
+
+    // Noise bound of the array, zero for both in streams written before noise tracking
+    double noise_bits() const noexcept { return _noise_bits; }
+    unsigned int noise_limit() const noexcept { return _noise_limit; }
+
+    // Read the next element. Returns false once all elements have been read
+    bool next(mpz_class & element);
+
+    // Read the remaining elements into an array
+    EncryptedArray read();
+
+ private:
+    std::istream & _input;
+    std::shared_ptr<const EvaluationContext> _context;
+    size_t _size;
+    size_t _remaining;
+    unsigned int _degree;
+    unsigned int _max_degree;
+    double _noise_bits;
+    unsigned int _noise_limit;
+};
+
+
+// Writes a compressed ciphertext delta by delta
+class CompressedCiphertextWriter
+{
+ public:
+    // Write the header of a ciphertext with `size` elements
+    CompressedCiphertextWriter( std::ostream & output
+                              , const ParameterSet & parameter_set
+                              , const mpz_class & public_element_delta
+                              , size_t size);
+
+    // Write the header and then all deltas of the ciphertext
+    CompressedCiphertextWriter(std::ostream & output, const CompressedCiphertext & ciphertext);
+
+    // Write the next element delta
+    void write(const mpz_class & element_delta);
+
+    size_t remaining() const noexcept { return _remaining; }
+
+ private:
+    std::ostream & _output;
+    size_t _remaining;
+};
+
+
+// Reads a compressed ciphertext and expands its elements as they arrive
+class CompressedCiphertextReader
+{
+ public:
+    // Read the header and restore the public element
+    CompressedCiphertextReader(std::istream & input);
+
+    size_t size() const noexcept { return _size; }
+    size_t remaining() const noexcept { return _remaining; }
+    const ParameterSet & parameter_set() const noexcept { return _parameter_set; }
+    const std::shared_ptr<const EvaluationContext> & context() const noexcept { return _context; }
+
+    // Read and expand the next element. Returns false once all elements have been read
+    bool next(mpz_class & element);
+
+    // Read and expand the remaining elements into an array
+    EncryptedArray expand();
+
+ private:
+    std::istream & _input;
+    ParameterSet _parameter_set;
+    std::unique_ptr<PseudoRandomStream> _prf_stream;
+    std::shared_ptr<const EvaluationContext> _context;
+    size_t _size;
+    size_t _remaining;
+    uint64_t _max_integer_bytes;
+};
+
+} // namespace she
@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <tuple>
+
+#include "she/bristol.hpp"
+#include "she/exceptions.hpp"
+
+using std::max;
+using std::string;
+using std::vector;
+
+
+namespace she
+{
+
+namespace
+{
+
+// Sizes come from the file, so the count and the sum are bounded by the wires left for them
+vector<size_t> read_sizes(std::istream & stream, size_t wires)
+{
+    size_t count = 0;
+    stream >> count;
+    ASSERT(stream && count <= wires, "Invalid circuit header");
+
+    vector<size_t> sizes(count);
+    for (auto & size : sizes) {
+        stream >> size;
+        ASSERT(stream && size <= wires, "Circuit has fewer wires than inputs and outputs");
+        wires -= size;
+    }
+
+    return sizes;
+}
+
+size_t total(const vector<size_t> & sizes) noexcept
+{
+    return std::accumulate(sizes.begin(), sizes.end(), size_t(0));
+}
+
+} // namespace
+
+
+BristolCircuit BristolCircuit::read(std::istream & stream)
+{
+    BristolCircuit circuit;
+
+    size_t gate_lines = 0;
+    stream >> gate_lines >> circuit._wire_count;
+    ASSERT(stream, "Invalid circuit header");
+
+    circuit._input_sizes = read_sizes(stream, circuit._wire_count);
+    circuit._output_sizes = read_sizes(stream, circuit._wire_count - total(circuit._input_sizes));
+
+    // Gates may only read wires that are inputs or outputs of earlier gates
+    vector<bool> defined(circuit._wire_count, false);
+    std::fill(defined.begin(), defined.begin() + total(circuit._input_sizes), true);
+
+    const auto wire = [&](size_t index, bool output) {
+        ASSERT(index < circuit._wire_count, "Wire " << index << " out of range");
+        ASSERT(output || defined[index], "Wire " << index << " is used before it is set");
+        ASSERT(!output || !defined[index], "Wire " << index << " is set twice");
+        defined[index] = true;
+        return index;
+    };
+
+    for (size_t line = 0; line < gate_lines; ++line) {
+        size_t input_count = 0;
+        size_t output_count = 0;
+        stream >> input_count >> output_count;
+
+        // Every gate sets distinct wires and reads at most two per output
+        ASSERT(stream && output_count <= circuit._wire_count && input_count / 2 <= output_count,
+               "Invalid gate on line " << line + 1);
+
+        vector<size_t> wires(input_count + output_count);
+        for (auto & index : wires) {
+            stream >> index;
+        }
+
+        string type;
+        stream >> type;
+        ASSERT(stream, "Invalid gate on line " << line + 1);
+
+        const auto expect = [&](size_t inputs, size_t outputs) {
+            ASSERT(input_count == inputs && output_count == outputs,
+                   "Gate " << type << " on line " << line + 1 << " has a wrong number of wires");
+        };
+
+        if (type == "XOR" || type == "AND") {
+            expect(2, 1);
+            const auto gate_type = (type == "XOR") ? GateType::XOR : GateType::AND;
+            const size_t a = wire(wires[0], false);
+            const size_t b = wire(wires[1], false);
+            circuit._gates.push_back({gate_type, a, b, wire(wires[2], true)});
+        } else if (type == "INV" || type == "EQW") {
+            expect(1, 1);
+            const auto gate_type = (type == "INV") ? GateType::INV : GateType::EQW;
+            const size_t a = wire(wires[0], false);
+            circuit._gates.push_back({gate_type, a, a, wire(wires[1], true)});
+        } else if (type == "EQ") {
+            expect(1, 1);
+            ASSERT(wires[0] <= 1, "Constant on line " << line + 1 << " is not a bit");
+            circuit._gates.push_back({GateType::EQ, wires[0], wires[0], wire(wires[1], true)});
+        } else if (type == "MAND") {
+            const size_t count = output_count;
+            expect(2 * count, count);
+            for (size_t i = 0; i < count; ++i) {
+                const size_t a = wire(wires[i], false);
+                const size_t b = wire(wires[count + i], false);
+                circuit._gates.push_back({GateType::AND, a, b, wire(wires[2 * count + i], true)});
+            }
+        } else {
+            ASSERT(false, "Unsupported gate " << type << " on line " << line + 1);
+        }
+    }
+
+    for (size_t index = circuit.output_offset(); index < circuit._wire_count; ++index) {
+        ASSERT(defined[index], "Output wire " << index << " is not set");
+    }
+
+    circuit.plan();
+    return circuit;
+}
+
+BristolCircuit BristolCircuit::load(const string & path)
+{
+    std::ifstream file(path);
+    ASSERT(file, "Cannot open circuit file " << path);
+
+    return read(file);
+}
+
+size_t BristolCircuit::output_offset() const noexcept
+{
+    return _wire_count - total(_output_sizes);
+}
+
+void BristolCircuit::plan() noexcept
+{
+    // Every wire is ready after the ANDs of its AND depth and a number of linear gates of the
+    // same depth. ANDs of one depth and linear gates of one depth and level do not depend on
+    // each other
+    vector<unsigned int> depths(_wire_count, 0);
+    vector<unsigned int> levels(_wire_count, 0);
+
+    using Stage = std::tuple<unsigned int, unsigned int, GateType>;
+    std::map<Stage, vector<size_t>> stages;
+
+    _and_depth = 0;
+    for (size_t i = 0; i < _gates.size(); ++i) {
+        const auto & gate = _gates[i];
+
+        unsigned int depth = 0;
+        unsigned int level = 0;
+
+        const auto level_at = [&](size_t wire, unsigned int depth) {
+            return (depths[wire] == depth) ? levels[wire] : 0;
+        };
+
+        switch (gate.type) {
+            case GateType::AND:
+                depth = max(depths[gate.a], depths[gate.b]) + 1;
+                break;
+            case GateType::XOR:
+                depth = max(depths[gate.a], depths[gate.b]);
+                level = max(level_at(gate.a, depth), level_at(gate.b, depth)) + 1;
+                break;
+            case GateType::INV:
+            case GateType::EQW:
+                depth = depths[gate.a];
+                level = levels[gate.a] + 1;
+                break;
+            case GateType::EQ:
+                break;
+        }
+
+        depths[gate.output] = depth;
+        levels[gate.output] = level;
+        _and_depth = max(_and_depth, depth);
+
+        stages[Stage(depth, level, gate.type)].push_back(i);
+    }
+
+    _batches.clear();
+    for (auto & stage : stages) {
+        _batches.push_back({std::get<2>(stage.first), std::move(stage.second), {}});
+    }
+
+    // Wires are released after the last batch that reads them. Inputs and outputs are kept
+    const size_t none = _batches.size();
+    vector<size_t> last_use(_wire_count, none);
+    for (size_t batch = 0; batch < _batches.size(); ++batch) {
+        if (_batches[batch].type == GateType::EQ) {
+            continue;
+        }
+        for (const auto i : _batches[batch].gates) {
+            last_use[_gates[i].a] = batch;
+            last_use[_gates[i].b] = batch;
+        }
+    }
+
+    for (size_t wire = total(_input_sizes); wire < output_offset(); ++wire) {
+        if (last_use[wire] != none) {
+            _batches[last_use[wire]].released.push_back(wire);
+        }
+    }
+}
+
+vector<PlaintextArray> BristolCircuit::evaluate(const vector<PlaintextArray> & inputs) const
+{
+    ASSERT(inputs.size() == _input_sizes.size(), "Circuit expects " << _input_sizes.size() << " inputs");
+
+    PlaintextArray wires {};
+    wires.resize(_wire_count);
+
+    size_t offset = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        ASSERT(inputs[i].size() == _input_sizes[i], "Input " << i << " must have " << _input_sizes[i] << " bits");
+        for (size_t j = 0; j < inputs[i].size(); ++j) {
+            wires.set(offset + j, inputs[i][j]);
+        }
+        offset += inputs[i].size();
+    }
+
+    for (const auto & gate : _gates) {
+        switch (gate.type) {
+            case GateType::XOR:
+                wires.set(gate.output, wires[gate.a] ^ wires[gate.b]);
+                break;
+            case GateType::AND:
+                wires.set(gate.output, wires[gate.a] & wires[gate.b]);
+                break;
+            case GateType::INV:
+                wires.set(gate.output, !wires[gate.a]);
+                break;
+            case GateType::EQ:
+                wires.set(gate.output, gate.a);
+                break;
+            case GateType::EQW:
+                wires.set(gate.output, wires[gate.a]);
+                break;
+        }
+    }
+
+    vector<PlaintextArray> outputs;
+
+    offset = output_offset();
+    for (const auto size : _output_sizes) {
+        PlaintextArray output {};
+        output.resize(size);
+        for (size_t j = 0; j < size; ++j) {
+            output.set(j, wires[offset + j]);
+        }
+        outputs.push_back(output);
+        offset += size;
+    }
+
+    return outputs;
+}
+
+vector<EncryptedArray> BristolCircuit::evaluate(const vector<EncryptedArray> & inputs) const
+{
+    ASSERT(inputs.size() == _input_sizes.size(), "Circuit expects " << _input_sizes.size() << " inputs");
+    ASSERT(inputs.size() > 0, "Circuit must have an input");
+
+    const auto & context = inputs.front().context();
+
+    unsigned int max_degree = 0;
+    unsigned int noise_limit = 0;
+    for (const auto & input : inputs) {
+        max_degree = max(max_degree, input.max_degree());
+        noise_limit = max(noise_limit, input.noise_limit());
+    }
+
+    // Encrypted bit, degree and noise bound of every wire
+    vector<mpz_class> wires(_wire_count);
+    vector<unsigned int> degrees(_wire_count, 0);
+    vector<double> noise(_wire_count, 0);
+
+    const auto add_noise = [](double a, double b) {
+        return max(a, b) + std::log2(1 + std::exp2(std::min(a, b) - max(a, b)));
+    };
+
+    size_t offset = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        ASSERT(inputs[i].size() == _input_sizes[i], "Input " << i << " must have " << _input_sizes[i] << " bits");
+        ASSERT(inputs[i].public_element() == inputs.front().public_element(), "Inputs must share the public element");
+
+        for (size_t j = 0; j < inputs[i].size(); ++j) {
+            wires[offset + j] = inputs[i].elements()[j];
+            degrees[offset + j] = inputs[i].degree();
+            noise[offset + j] = inputs[i].noise_bits();
+        }
+        offset += inputs[i].size();
+    }
+
+    // Array of the given operand of every gate of the batch
+    const auto gather = [&](const Batch & batch, bool first) {
+        unsigned int degree = 0;
+        double noise_bits = 0;
+        for (const auto i : batch.gates) {
+            const size_t wire = first ? _gates[i].a : _gates[i].b;
+            degree = max(degree, degrees[wire]);
+            noise_bits = max(noise_bits, noise[wire]);
+        }
+
+        EncryptedArray array(context, max_degree, degree);
+        array.set_noise(noise_bits, noise_limit);
+        array.elements().reserve(batch.gates.size());
+        for (const auto i : batch.gates) {
+            array.elements().push_back(wires[first ? _gates[i].a : _gates[i].b]);
+        }
+
+        return array;
+    };
+
+    for (const auto & batch : _batches) {
+        const auto & gates = batch.gates;
+
+        switch (batch.type) {
+            case GateType::XOR:
+            case GateType::AND: {
+                auto array = gather(batch, true);
+                const auto other = gather(batch, false);
+
+                if (batch.type == GateType::XOR) {
+                    array ^= other;
+                } else {
+                    array &= other;
+                }
+
+                for (size_t k = 0; k < gates.size(); ++k) {
+                    const auto & gate = _gates[gates[k]];
+                    wires[gate.output] = std::move(array.elements()[k]);
+                    if (batch.type == GateType::XOR) {
+                        degrees[gate.output] = max(degrees[gate.a], degrees[gate.b]);
+                        noise[gate.output] = add_noise(noise[gate.a], noise[gate.b]);
+                    } else {
+                        degrees[gate.output] = degrees[gate.a] + degrees[gate.b];
+                        noise[gate.output] = noise[gate.a] + noise[gate.b];
+                    }
+                }
+                break;
+            }
+            case GateType::INV: {
+                auto array = gather(batch, true);
+                array ^= PlaintextArray(vector<bool>(gates.size(), true));
+
+                for (size_t k = 0; k < gates.size(); ++k) {
+                    const auto & gate = _gates[gates[k]];
+                    wires[gate.output] = std::move(array.elements()[k]);
+                    degrees[gate.output] = degrees[gate.a];
+                    noise[gate.output] = add_noise(noise[gate.a], 0);
+                }
+                break;
+            }
+            case GateType::EQ:
+                // Trivial encryptions of the constants
+                for (const auto i : gates) {
+                    wires[_gates[i].output] = static_cast<unsigned long>(_gates[i].a);
+                    degrees[_gates[i].output] = 0;
+                    noise[_gates[i].output] = 0;
+                }
+                break;
+            case GateType::EQW:
+                for (const auto i : gates) {
+                    wires[_gates[i].output] = wires[_gates[i].a];
+                    degrees[_gates[i].output] = degrees[_gates[i].a];
+                    noise[_gates[i].output] = noise[_gates[i].a];
+                }
+                break;
+        }
+
+        for (const auto wire : batch.released) {
+            mpz_class().swap(wires[wire]);
+        }
+    }
+
+    vector<EncryptedArray> outputs;
+
+    offset = output_offset();
+    for (const auto size : _output_sizes) {
+        unsigned int degree = 0;
+        double noise_bits = 0;
+        for (size_t j = 0; j < size; ++j) {
+            degree = max(degree, degrees[offset + j]);
+            noise_bits = max(noise_bits, noise[offset + j]);
+        }
+
+        EncryptedArray output(context, max_degree, degree);
+        output.set_noise(noise_bits, noise_limit);
+        output.elements().assign(wires.begin() + offset, wires.begin() + offset + size);
+        outputs.push_back(std::move(output));
+        offset += size;
+    }
+
+    return outputs;
+}
+
+} // namespace she
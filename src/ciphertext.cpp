@@ -1,80 +1,279 @@
+#include <atomic>
 #include <cmath>
+#include <limits>
 
 #include "she.hpp"
 #include "she/exceptions.hpp"
+#include "she/database.hpp"
+#include "she/parallel.hpp"
+#include "she/store.hpp"
 
 using std::min;
 using std::max;
-using std::set;
 using std::vector;
 
 
 namespace she
 {
 
-std::set<mpz_class> EncryptedArray::public_elements = {};
+namespace
+{
+
+// Number of records read from a record source before they are added to the result
+const size_t RECORD_BLOCK_SIZE = 256;
+
+// Largest block of selector elements combined into a table of subset sums
+const unsigned int MAX_SUBSET_SUM_BITS = 8;
+
+// Mask of the bits of word number `word` of a packed array that lie below `size`
+PlaintextArray::word_t word_mask(size_t size, size_t word) noexcept
+{
+    if (size >= 64 * (word + 1)) {
+        return ~PlaintextArray::word_t(0);
+    }
+    return (PlaintextArray::word_t(1) << (size % 64)) - 1;
+}
+
+std::atomic<bool> global_noise_check(false);
+
+// Noise bounds are log2 of an upper bound on the noise of every element. Noise is positive, so
+// bounds of sums and products are sums and products of bounds. Trivial encryptions have a
+// bound of zero bits
+
+// Bound of a sum of elements with noise bounds `a` and `b`
+double add_noise(double a, double b) noexcept
+{
+    return max(a, b) + std::log2(1 + std::exp2(min(a, b) - max(a, b)));
+}
+
+// Bound of a sum of `count` elements with noise bound `a`
+double sum_noise(double a, size_t count) noexcept
+{
+    return (count == 0) ? 0 : a + std::log2(double(count));
+}
+
+// Refuse an operation whose result could exceed the limit, before it is computed
+void check_noise(double noise_bits, unsigned int limit)
+{
+    if (global_noise_check && limit > 0) {
+        ASSERT(noise_bits < limit, "Noise of " << noise_bits << " bits would exceed the limit of " << limit << " bits");
+    }
+}
+
+// Elements equal to 0 or 1 are trivial encryptions of a known bit, such as padding taken from
+// plaintext operands. They carry no noise, so arithmetic on them is folded
+bool is_trivial(const mpz_class & element) noexcept
+{
+    return sgn(element) >= 0 && mpz_cmp_ui(element.get_mpz_t(), 1) <= 0;
+}
+
+// Add one modulo public element. A reduced element reaches the public element at most, so
+// reduction is needed only past it
+void increment(mpz_class & value, const ReductionContext & context, unsigned int headroom_bits) noexcept
+{
+    mpz_add_ui(value.get_mpz_t(), value.get_mpz_t(), 1);
+    if (mpz_cmp(value.get_mpz_t(), context.modulus().get_mpz_t()) >= 0) {
+        context.reduce(value, headroom_bits);
+    }
+}
+
+// Modular addition of other to value in place, folding a trivial operand
+void add(mpz_class & value, const mpz_class & other, const ReductionContext & context, unsigned int headroom_bits) noexcept
+{
+    if (is_trivial(other)) {
+        if (other != 0) {
+            increment(value, context, headroom_bits);
+        }
+        return;
+    }
+
+    value += other;
+    context.reduce(value, headroom_bits);
+}
+
+// Modular multiplication of value by other in place, folding trivial operands: multiplication
+// by 0 gives 0 and multiplication by 1 gives the other operand
+void multiply(mpz_class & value, const mpz_class & other, const ReductionContext & context) noexcept
+{
+    if (is_trivial(other)) {
+        if (other == 0) {
+            value = 0;
+        }
+        return;
+    }
+
+    if (is_trivial(value)) {
+        if (value != 0) {
+            value = other;
+            context.reduce(value);
+        }
+        return;
+    }
+
+    context.multiply(value, other);
+}
+
+// Multiply the first `count` values modulo public element as a balanced binary tree. Values are overwritten
+mpz_class balanced_product(vector<mpz_class> & values, size_t count, const ReductionContext & context) noexcept
+{
+    if (count == 0) {
+        return 1;
+    }
+
+    for (size_t stride = 1; stride < count; stride *= 2) {
+        for (size_t i = 0; i + stride < count; i += 2 * stride) {
+            multiply(values[i], values[i + stride], context);
+        }
+    }
+
+    context.reduce(values[0]);
+    return values[0];
+}
+
+// Product of (a_i + b_i + 1) modulo public element, the shorter operand padded with zeros. The
+// product decrypts to 1 iff the operands are equal. Sums are formed in the scratch buffer, which
+// keeps its allocations between calls
+mpz_class equality_product( const vector<mpz_class> & a
+                          , const vector<mpz_class> & b
+                          , vector<mpz_class> & scratch
+                          , const ReductionContext & context) noexcept
+{
+    const size_t n = min(a.size(), b.size());
+    const auto & longer = (a.size() > b.size()) ? a : b;
+
+    if (scratch.size() < longer.size()) {
+        scratch.resize(longer.size());
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        mpz_add(scratch[i].get_mpz_t(), a[i].get_mpz_t(), b[i].get_mpz_t());
+        mpz_add_ui(scratch[i].get_mpz_t(), scratch[i].get_mpz_t(), 1);
+    }
+    for (size_t i = n; i < longer.size(); ++i) {
+        mpz_add_ui(scratch[i].get_mpz_t(), longer[i].get_mpz_t(), 1);
+    }
+
+    return balanced_product(scratch, longer.size(), context);
+}
+
+mpz_class equality_product( const vector<mpz_class> & a
+                          , const PlaintextArray & b
+                          , vector<mpz_class> & scratch
+                          , const ReductionContext & context) noexcept
+{
+    const size_t n = min(a.size(), b.size());
+    const size_t size = max(a.size(), b.size());
+
+    if (scratch.size() < size) {
+        scratch.resize(size);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        mpz_add_ui(scratch[i].get_mpz_t(), a[i].get_mpz_t(), 1 + b[i]);
+    }
+    for (size_t i = n; i < a.size(); ++i) {
+        mpz_add_ui(scratch[i].get_mpz_t(), a[i].get_mpz_t(), 1);
+    }
+    for (size_t i = n; i < b.size(); ++i) {
+        scratch[i] = 1 + b[i];
+    }
+
+    return balanced_product(scratch, size, context);
+}
 
-EncryptedArray::EncryptedArray(const mpz_class & x, unsigned int max_degree, unsigned int degree) noexcept :
+} // namespace
+
+EncryptedArray::EncryptedArray(const mpz_class & x, unsigned int max_degree, unsigned int degree) :
   _degree(degree),
-  _max_degree(max_degree)
+  _max_degree(max_degree),
+  _noise_bits(0),
+  _noise_limit_bits(0),
+  _lazy_reduction_bits(0)
 {
     // ASSERT(degree >= 1, "Degree must be at least 1");
 
     set_public_element(x);
 }
 
+EncryptedArray::EncryptedArray( std::shared_ptr<const EvaluationContext> context
+                              , unsigned int max_degree
+                              , unsigned int degree) :
+  _degree(degree),
+  _max_degree(max_degree),
+  _noise_bits(0),
+  _noise_limit_bits(0),
+  _lazy_reduction_bits(0),
+  _context(std::move(context))
+{}
+
 bool EncryptedArray::operator==(const EncryptedArray & other) const noexcept
 {
     return (_elements == other._elements)
-        && (*_public_element_ptr == *other._public_element_ptr);
+        && (_context == other._context || public_element() == other.public_element());
 }
 
-void EncryptedArray::set_public_element(const mpz_class & x) noexcept
+void EncryptedArray::set_public_element(const mpz_class & x)
 {
-    auto result = public_elements.emplace(x);
-    _public_element_ptr = result.first;
-    _initialized = true;
+    // Precompute reduction data only once per public element
+    _context = EvaluationContext::get(x);
 }
 
 EncryptedArray &
-EncryptedArray::operator^=(const PlaintextArray & other) noexcept
+EncryptedArray::operator^=(const PlaintextArray & other)
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
+    ASSERT(_context, "EncryptedArray must be initialized");
 
-    const auto & public_element = *_public_element_ptr;
+    const auto & context = reduction_context();
 
-    const size_t n = min(_elements.size(), other._elements.size());
+    // Noise grows by at most one
+    const double noise = (other.size() > 0) ? add_noise(_noise_bits, 0) : _noise_bits;
+    check_noise(noise, _noise_limit_bits);
+    _noise_bits = noise;
 
-    // Do natural arithmetic operation modulo public element
-    for (size_t i = 0; i < n; ++i) {
-        _elements[i] += other._elements[i];
-        _elements[i] %= public_element;
-    }
+    const size_t n = min(_elements.size(), other.size());
+
+    // Adding a zero bit leaves the element as it is, adding a one is an increment
+    parallel_for((n + 63) / 64, [&](size_t begin, size_t end) {
+        for (size_t w = begin; w < end; ++w) {
+            auto word = other.words()[w] & word_mask(n, w);
+            while (word != 0) {
+                increment(_elements[64 * w + __builtin_ctzll(word)], context, _lazy_reduction_bits);
+                word &= word - 1;
+            }
+        }
+    });
 
     // If sizes don't match pad with zeros from the right
-    for (size_t i = n; i < other._elements.size(); ++i) {
-        _elements.push_back(other._elements[i]);
+    for (size_t i = n; i < other.size(); ++i) {
+        _elements.push_back(other[i]);
     }
 
     return *this;
 }
 
 EncryptedArray &
-EncryptedArray::operator^=(const EncryptedArray & other) noexcept
+EncryptedArray::operator^=(const EncryptedArray & other)
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
+    ASSERT(_context, "EncryptedArray must be initialized");
+
+    const auto & context = reduction_context();
 
-    const auto & public_element = *_public_element_ptr;
+    const unsigned int limit = max(_noise_limit_bits, other._noise_limit_bits);
+    const double noise = add_noise(_noise_bits, other._noise_bits);
+    check_noise(noise, limit);
+    _noise_bits = noise;
+    _noise_limit_bits = limit;
 
     _degree = max(_degree, other._degree);
 
     const size_t n = min(_elements.size(), other._elements.size());
 
     // Do natural arithmetic operation modulo public element
-    for (size_t i = 0; i < n; ++i) {
-        _elements[i] += other._elements[i];
-        _elements[i] %= public_element;
-    }
+    parallel_for(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            add(_elements[i], other._elements[i], context, _lazy_reduction_bits);
+        }
+    });
 
     // If sizes don't match pad with zeros from the right
     for (size_t i = n; i < other._elements.size(); ++i) {
@@ -87,42 +286,57 @@ EncryptedArray::operator^=(const EncryptedArray & other) noexcept
 EncryptedArray &
 EncryptedArray::operator&=(const PlaintextArray & other) noexcept
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
-
-    const auto & public_element = *_public_element_ptr;
-
-    const size_t n = min(_elements.size(), other._elements.size());
-
-    // Do natural arithmetic operation modulo public element
-    for (size_t i = 0; i < n; ++i) {
-        _elements[i] *= other._elements[i];
-        _elements[i] %= public_element;
-    }
+    ASSERT(_context, "EncryptedArray must be initialized");
+
+    const size_t n = min(_elements.size(), other.size());
+
+    // Multiplying by a one bit keeps the element, multiplying by a zero clears it
+    parallel_for((n + 63) / 64, [&](size_t begin, size_t end) {
+        for (size_t w = begin; w < end; ++w) {
+            auto word = ~other.words()[w] & word_mask(n, w);
+            while (word != 0) {
+                _elements[64 * w + __builtin_ctzll(word)] = 0;
+                word &= word - 1;
+            }
+        }
+    });
 
     // If sizes don't match pad with ones from the right
-    for (size_t i = n; i < other._elements.size(); ++i) {
-        _elements.push_back(other._elements[i]);
+    for (size_t i = n; i < other.size(); ++i) {
+        _elements.push_back(other[i]);
     }
 
     return *this;
 }
 
 EncryptedArray &
-EncryptedArray::operator&=(const EncryptedArray & other) noexcept
+EncryptedArray::operator&=(const EncryptedArray & other)
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
-
-    const auto & public_element = *_public_element_ptr;
+    ASSERT(_context, "EncryptedArray must be initialized");
 
-    _degree = _degree + other._degree;
+    const auto & context = reduction_context();
 
     const size_t n = min(_elements.size(), other._elements.size());
 
-    // Do natural arithmetic operation modulo public element
-    for (size_t i = 0; i < n; ++i) {
-        _elements[i] *= other._elements[i];
-        _elements[i] %= public_element;
+    // Degrees do not add up if every product has a trivial operand
+    bool folded = n > 0;
+    for (size_t i = 0; i < n && folded; ++i) {
+        folded = is_trivial(_elements[i]) || is_trivial(other._elements[i]);
     }
+    const unsigned int limit = max(_noise_limit_bits, other._noise_limit_bits);
+    const double noise = folded ? max(_noise_bits, other._noise_bits) : _noise_bits + other._noise_bits;
+    check_noise(noise, limit);
+    _noise_bits = noise;
+    _noise_limit_bits = limit;
+
+    _degree = folded ? max(_degree, other._degree) : _degree + other._degree;
+
+    // Do natural arithmetic operation modulo public element
+    parallel_for(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            multiply(_elements[i], other._elements[i], context);
+        }
+    });
 
     // If sizes don't match pad with ones from the right
     for (size_t i = n; i < other._elements.size(); ++i) {
@@ -133,62 +347,116 @@ EncryptedArray::operator&=(const EncryptedArray & other) noexcept
 }
 
 
-const PlaintextArray
-PlaintextArray::equal(const std::vector<PlaintextArray> & arrays) const noexcept
+const EncryptedArray
+PlaintextArray::equal(const std::vector<EncryptedArray> & arrays) const
 {
     ASSERT(arrays.size() > 0, "Input array must not be empty");
 
-    PlaintextArray result {};
+    const auto & context = arrays.front().reduction_context();
+
+    EncryptedArray result( arrays.front().context()
+                         , arrays.front().max_degree()
+                         , arrays.front().degree()
+                         );
 
+    // Product of a + b + 1 <= a + 2 over all elements
     for (const auto & array : arrays) {
+        const double factor = add_noise(array._noise_bits, 1);
+        result._noise_bits = max(result._noise_bits, max(array.size(), size()) * factor);
+        result._noise_limit_bits = max(result._noise_limit_bits, array._noise_limit_bits);
+    }
+    check_noise(result._noise_bits, result._noise_limit_bits);
 
-        // Find difference (xor) between this and array
-        const auto difference = *this ^ array;
+    result._elements.resize(arrays.size());
 
-        // Multiply (and) all elements of the difference array + 1
-        // The result will decrypt to 1 iff all elements of this and array are equal
-        bool all = 1;
-        for (const auto & element : difference._elements)
-        {
-            all &= (element ^ 1);
+    // Multiply (and) all elements of the difference (xor) between this and array + 1
+    // The result will decrypt to 1 iff all elements of this and array are equal
+    parallel_for(arrays.size(), [&](size_t begin, size_t end) {
+        vector<mpz_class> scratch;
+        for (size_t i = begin; i < end; ++i) {
+            result._elements[i] = equality_product(arrays[i]._elements, *this, scratch, context);
         }
+    });
 
-        result._elements.push_back(all);
+    // Set result degree to maximum degree of arrays
+    for (const auto & array : arrays) {
+        auto current_degree = array._degree * max(array.size(), size());
+        if (current_degree > result._degree) {
+            result._degree = current_degree;
+        }
     }
 
     return result;
 }
 
 const EncryptedArray
-PlaintextArray::equal(const std::vector<EncryptedArray> & arrays) const noexcept
+EncryptedArray::equal(const std::vector<PlaintextArray> & arrays) const
 {
+    ASSERT(_context, "EncryptedArray must be initialized");
     ASSERT(arrays.size() > 0, "Input array must not be empty");
 
-    const auto & public_element = arrays.front().public_element();
+    const auto & context = reduction_context();
 
-    EncryptedArray result( arrays.front().public_element()
-                         , arrays.front().max_degree()
-                         , arrays.front().degree()
-                         );
+    EncryptedArray result(_context, _max_degree, _degree);
+    result._lazy_reduction_bits = _lazy_reduction_bits;
 
+    // Product of a + b + 1 <= a + 2 over all elements
+    result._noise_limit_bits = _noise_limit_bits;
     for (const auto & array : arrays) {
+        const double factor = add_noise(_noise_bits, 1);
+        result._noise_bits = max(result._noise_bits, max(array.size(), size()) * factor);
+    }
+    check_noise(result._noise_bits, result._noise_limit_bits);
 
-        // Find difference (xor) between this and array
-        const auto difference = array ^ *this;
+    result._elements.resize(arrays.size());
 
-        // Multiply (and) all elements of the difference array + 1
-        // The result will decrypt to 1 iff all elements of this and array are equal
-        mpz_class all = 1;
-        for (const auto & element : difference._elements)
-        {
-            all *= (element + 1);
-            all %= public_element;
+    // Multiply (and) all elements of the difference (xor) between this and array + 1
+    // The result will decrypt to 1 iff all elements of this and array are equal
+    parallel_for(arrays.size(), [&](size_t begin, size_t end) {
+        vector<mpz_class> scratch;
+        for (size_t i = begin; i < end; ++i) {
+            result._elements[i] = equality_product(_elements, arrays[i], scratch, context);
         }
+    });
+
+    return result;
+}
+
+
+const EncryptedArray
+EncryptedArray::equal(const std::vector<EncryptedArray> & arrays) const
+{
+    ASSERT(_context, "EncryptedArray must be initialized");
+    ASSERT(arrays.size() > 0, "Input array must not be empty");
+
+    const auto & context = reduction_context();
+
+    EncryptedArray result(_context, _max_degree);
+    result._lazy_reduction_bits = _lazy_reduction_bits;
+
+    // Product of a + b + 1 over all elements
+    result._noise_limit_bits = _noise_limit_bits;
+    for (const auto & array : arrays) {
+        const double factor = add_noise(add_noise(_noise_bits, array._noise_bits), 0);
+        result._noise_bits = max(result._noise_bits, max(array.size(), size()) * factor);
+        result._noise_limit_bits = max(result._noise_limit_bits, array._noise_limit_bits);
+    }
+    check_noise(result._noise_bits, result._noise_limit_bits);
 
-        result._elements.push_back(all);
+    result._elements.resize(arrays.size());
 
-        // Set result degree to maximum degree of arrays
-        auto current_degree = difference._degree * difference._elements.size();
+    // Multiply (and) all elements of the difference (xor) between this and array + 1
+    // The result will decrypt to 1 iff all elements of this and array are equal
+    parallel_for(arrays.size(), [&](size_t begin, size_t end) {
+        vector<mpz_class> scratch;
+        for (size_t i = begin; i < end; ++i) {
+            result._elements[i] = equality_product(_elements, arrays[i]._elements, scratch, context);
+        }
+    });
+
+    // Set result degree to maximum degree of arrays
+    for (const auto & array : arrays) {
+        auto current_degree = max(_degree, array._degree) * max(array.size(), size());
         if (current_degree > result._degree) {
             result._degree = current_degree;
         }
@@ -198,187 +466,480 @@ PlaintextArray::equal(const std::vector<EncryptedArray> & arrays) const noexcept
 }
 
 const EncryptedArray
-EncryptedArray::equal(const std::vector<PlaintextArray> & arrays) const noexcept
+PlaintextArray::select(const std::vector<EncryptedArray> & arrays) const
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
     ASSERT(arrays.size() > 0, "Input array must not be empty");
 
-    const auto & public_element = *_public_element_ptr;
+    const auto & context = arrays.front().reduction_context();
 
-    EncryptedArray result(public_element, _max_degree, _degree);
-
-    for (const auto & array : arrays) {
+    EncryptedArray result( arrays.front().context()
+                         , arrays.front().max_degree()
+                         , arrays.front().degree()
+                         );
 
-        // Find difference (xor) between this and array
-        const auto difference = *this ^ array;
+    const size_t n = min(_size, arrays.size());
 
-        // Multiply (and) all elements of the difference array + 1
-        // The result will decrypt to 1 iff all elements of this and array are equal
-        mpz_class all = 1;
-        for (const auto & element : difference._elements)
-        {
-            all *= (element + 1);
-            all %= public_element;
+    // If sizes don't match pad with zeros from the right
+    size_t size = 0;
+    bool selected = false;
+    for (size_t i = 0; i < n; ++i) {
+        size = max(size, arrays[i].size());
+        result._degree = max(result._degree, arrays[i]._degree);
+        result._noise_limit_bits = max(result._noise_limit_bits, arrays[i]._noise_limit_bits);
+
+        // Sum of the selected arrays
+        if ((*this)[i]) {
+            result._noise_bits = selected ? add_noise(result._noise_bits, arrays[i]._noise_bits) : arrays[i]._noise_bits;
+            selected = true;
         }
-
-        result._elements.push_back(all);
     }
+    check_noise(result._noise_bits, result._noise_limit_bits);
+    result._elements.resize(size);
+
+    // Add j-th elements of arrays for which i-th element of this is one
+    // The result will be decrypted to either selected array or to array of zeros
+    parallel_for(size, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            for (size_t i = 0; i < n; ++i) {
+                if ((*this)[i] && j < arrays[i].size()) {
+                    add(result._elements[j], arrays[i]._elements[j], context, 0);
+                }
+            }
+        }
+    });
 
     return result;
 }
 
-
 const EncryptedArray
-EncryptedArray::equal(const std::vector<EncryptedArray> & arrays) const noexcept
+EncryptedArray::select(const std::vector<PlaintextArray> & arrays) const
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
+    ASSERT(_context, "EncryptedArray must be initialized");
     ASSERT(arrays.size() > 0, "Input array must not be empty");
 
-    const auto & public_element = *_public_element_ptr;
+    const auto & context = reduction_context();
 
-    EncryptedArray result(public_element, _max_degree);
+    EncryptedArray result(_context, _max_degree, _degree);
+    result._lazy_reduction_bits = _lazy_reduction_bits;
 
-    for (const auto & array : arrays) {
-
-        // Find difference (xor) between this and array
-        const auto difference = *this ^ array;
-
-        // Multiply (and) all elements of the difference array + 1
-        // The result will decrypt to 1 iff all elements of this and array are equal
-        mpz_class all = 1;
-        for (const auto & element : difference._elements)
-        {
-            all *= (element + 1);
-            all %= public_element;
-        }
+    const size_t n = min(_elements.size(), arrays.size());
 
-        result._elements.push_back(all);
+    // Sum of at most n elements of this
+    result._noise_bits = sum_noise(_noise_bits, n);
+    result._noise_limit_bits = _noise_limit_bits;
+    check_noise(result._noise_bits, result._noise_limit_bits);
 
-        // Set result degree to maximum degree of arrays
-        auto current_degree = difference._degree * difference._elements.size();
-        if (current_degree > result._degree) {
-            result._degree = current_degree;
-        }
+    // If sizes don't match pad with zeros from the right
+    size_t size = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size = max(size, arrays[i].size());
     }
+    result._elements.resize(size);
+
+    // Add i-th element of this to the result wherever the i-th record has a one, skip zeros
+    // The sum will be decrypted to either original array or to array of zeros
+    parallel_for(size, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            for (size_t i = 0; i < n; ++i) {
+                const auto & record = arrays[i];
+                if (j < record.size() && record[j]) {
+                    result._elements[j] += _elements[i];
+                    context.reduce(result._elements[j], _lazy_reduction_bits);
+                }
+            }
+        }
+    });
 
     return result;
 }
 
-const PlaintextArray
-PlaintextArray::select(const std::vector<PlaintextArray> & arrays) const noexcept
+const EncryptedArray
+EncryptedArray::select(const std::vector<PlaintextArray> & arrays, unsigned int block_bits) const
 {
+    ASSERT(_context, "EncryptedArray must be initialized");
     ASSERT(arrays.size() > 0, "Input array must not be empty");
+    ASSERT(block_bits <= MAX_SUBSET_SUM_BITS, "Block size is too large");
 
-    PlaintextArray result {};
+    const auto & context = reduction_context();
 
-    for (size_t i = 0; i < min(_elements.size(), arrays.size()); ++i) {
+    EncryptedArray result(_context, _max_degree, _degree);
+    result._lazy_reduction_bits = _lazy_reduction_bits;
 
-        PlaintextArray selected {};
+    const size_t n = min(_elements.size(), arrays.size());
 
-        // Multiply i-th element of this by all of the elements in array
-        // The result will be decrypted to either original array or to array of zeros
-        for (const auto & selected_element : arrays[i]._elements) {
-            selected._elements.push_back(selected_element & _elements[i]);
+    // Sum of at most n elements of this
+    result._noise_bits = sum_noise(_noise_bits, n);
+    result._noise_limit_bits = _noise_limit_bits;
+    check_noise(result._noise_bits, result._noise_limit_bits);
+
+    // If sizes don't match pad with zeros from the right
+    size_t size = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size = max(size, arrays[i].size());
+    }
+    result._elements.resize(size);
+
+    // A table costs 2^k additions and saves about k/2 additions per column
+    if (block_bits == 0) {
+        block_bits = 1;
+        while (block_bits < MAX_SUBSET_SUM_BITS && (size_t(2) << block_bits) <= size) {
+            ++block_bits;
         }
+    }
+
+    vector<mpz_class> subset_sums(size_t(1) << block_bits);
+
+    for (size_t first = 0; first < n; first += block_bits) {
+        const size_t count = min<size_t>(block_bits, n - first);
 
-        result ^= selected;
+        // Sum of the elements for every subset of the block, built from the subset without its highest element
+        subset_sums[0] = 0;
+        for (size_t subset = 1; subset < (size_t(1) << count); ++subset) {
+            size_t highest = 0;
+            while ((subset >> (highest + 1)) != 0) {
+                ++highest;
+            }
+
+            subset_sums[subset] = subset_sums[subset ^ (size_t(1) << highest)] + _elements[first + highest];
+            context.reduce(subset_sums[subset]);
+        }
+
+        // Add the sum for the subset of records that have a one in the column
+        parallel_for(size, [&](size_t begin, size_t end) {
+            for (size_t j = begin; j < end; ++j) {
+                size_t subset = 0;
+                for (size_t k = 0; k < count; ++k) {
+                    const auto & record = arrays[first + k];
+                    if (j < record.size() && record[j]) {
+                        subset |= size_t(1) << k;
+                    }
+                }
+
+                if (subset != 0) {
+                    result._elements[j] += subset_sums[subset];
+                    context.reduce(result._elements[j], _lazy_reduction_bits);
+                }
+            }
+        });
     }
 
     return result;
 }
 
 const EncryptedArray
-PlaintextArray::select(const std::vector<EncryptedArray> & arrays) const noexcept
+EncryptedArray::select(const std::vector<EncryptedArray> & arrays) const
 {
+    ASSERT(_context, "EncryptedArray must be initialized");
     ASSERT(arrays.size() > 0, "Input array must not be empty");
 
-    const auto & public_element = arrays.front().public_element();
-
-    EncryptedArray result( arrays.front().public_element()
-                         , arrays.front().max_degree()
-                         , arrays.front().degree()
-                         );
+    const auto & context = reduction_context();
 
-    for (size_t i = 0; i < min(_elements.size(), arrays.size()); ++i) {
+    EncryptedArray result(_context, _max_degree);
+    result._lazy_reduction_bits = _lazy_reduction_bits;
 
-        EncryptedArray selected(public_element, result._max_degree, arrays[i]._degree);
+    const size_t n = min(_elements.size(), arrays.size());
 
-        // Multiply i-th element of this by all of the elements in array
-        // The result will be decrypted to either original array or to array of zeros
-        for (const auto & selected_element : arrays[i]._elements) {
-            selected._elements.push_back((selected_element * _elements[i]) % public_element);
-        }
+    // If sizes don't match pad with zeros from the right
+    size_t size = 0;
+    result._noise_limit_bits = _noise_limit_bits;
+    for (size_t i = 0; i < n; ++i) {
+        size = max(size, arrays[i].size());
+        result._degree = max(result._degree, _degree + arrays[i]._degree);
 
-        result ^= selected;
+        // Sum of products of elements of this and of the arrays
+        const double product_noise = _noise_bits + arrays[i]._noise_bits;
+        result._noise_bits = (i == 0) ? product_noise : add_noise(result._noise_bits, product_noise);
+        result._noise_limit_bits = max(result._noise_limit_bits, arrays[i]._noise_limit_bits);
     }
+    check_noise(result._noise_bits, result._noise_limit_bits);
+    result._elements.resize(size);
+
+    // Multiply i-th element of this by all of the elements in i-th array and add up
+    // The result will be decrypted to either selected array or to array of zeros
+    parallel_for(size, [&](size_t begin, size_t end) {
+        mpz_class selected_element;
+
+        for (size_t j = begin; j < end; ++j) {
+            for (size_t i = 0; i < n; ++i) {
+                if (j < arrays[i].size()) {
+                    selected_element = arrays[i]._elements[j];
+                    multiply(selected_element, _elements[i], context);
+                    add(result._elements[j], selected_element, context, _lazy_reduction_bits);
+                }
+            }
+        }
+    });
 
     return result;
 }
 
 const EncryptedArray
-EncryptedArray::select(const std::vector<PlaintextArray> & arrays) const noexcept
+EncryptedArray::select(const EncryptedArrayStore & records) const
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
-    ASSERT(arrays.size() > 0, "Input array must not be empty");
+    ASSERT(_context, "EncryptedArray must be initialized");
+    ASSERT(records.size() > 0, "Input array must not be empty");
+    ASSERT(records.public_element() == public_element(), "Arrays must have the same public element");
+
+    const auto & context = reduction_context();
+
+    EncryptedArray result(_context, _max_degree);
+    result._lazy_reduction_bits = _lazy_reduction_bits;
+
+    const size_t n = min(_elements.size(), records.size());
+
+    // If sizes don't match pad with zeros from the right
+    size_t size = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size = max(size, records[i].size());
+        result._degree = max(result._degree, _degree + records[i].degree());
+
+        // Sum of products of elements of this and of the records
+        const double product_noise = _noise_bits + records[i].noise_bits();
+        result._noise_bits = (i == 0) ? product_noise : add_noise(result._noise_bits, product_noise);
+    }
 
-    const auto & public_element = *_public_element_ptr;
+    // Stores written without noise bounds are not checked
+    result._noise_limit_bits = (records.noise_limit() == 0) ? 0 : max(_noise_limit_bits, records.noise_limit());
+    check_noise(result._noise_bits, result._noise_limit_bits);
+    result._elements.resize(size);
 
-    EncryptedArray result(public_element, _max_degree, _degree);
+    // Stored elements are reduced, so only the selector needs reducing before multiplication
+    vector<mpz_class> selector(_elements.begin(), _elements.begin() + n);
+    for (auto & element : selector) {
+        context.reduce(element);
+    }
 
-    for (size_t i = 0; i < min(_elements.size(), arrays.size()); ++i) {
+    // Walk the arrays in file order, every thread reads its range of elements of each array
+    parallel_for(size, [&](size_t begin, size_t end) {
+        mpz_class selected_element;
+        mpz_t storage;
+
+        for (size_t i = 0; i < n; ++i) {
+            const auto record = records[i];
+            for (size_t j = begin; j < min(end, record.size()); ++j) {
+                mpz_mul(selected_element.get_mpz_t(), record.element(j, storage), selector[i].get_mpz_t());
+                context.reduce(selected_element);
+                result._elements[j] += selected_element;
+                context.reduce(result._elements[j], _lazy_reduction_bits);
+            }
+        }
+    });
 
-        EncryptedArray selected(public_element, _max_degree, _degree);
+    return result;
+}
 
-        // Multiply i-th element of this by all of the elements in array
-        // The result will be decrypted to either original array or to array of zeros
-        for (const auto & selected_element : arrays[i]._elements) {
-            selected._elements.push_back(selected_element * _elements[i]);
+const EncryptedArray
+EncryptedArray::select(RecordSource & records) const
+{
+    ASSERT(_context, "EncryptedArray must be initialized");
+
+    const auto & context = reduction_context();
+
+    EncryptedArray result(_context, _max_degree, _degree);
+    result._lazy_reduction_bits = _lazy_reduction_bits;
+
+    // Sum of at most one element of this per record
+    result._noise_bits = sum_noise(_noise_bits, _elements.size());
+    result._noise_limit_bits = _noise_limit_bits;
+    check_noise(result._noise_bits, result._noise_limit_bits);
+
+    // Records are read in blocks and every block is added to the result in parallel over columns.
+    // Records past the size of this array are not read
+    vector<PlaintextArray> block(RECORD_BLOCK_SIZE);
+    size_t first = 0;
+    bool exhausted = false;
+
+    while (!exhausted && first < _elements.size()) {
+        size_t count = 0;
+        while (count < block.size() && first + count < _elements.size()) {
+            if (!records.next(block[count])) {
+                exhausted = true;
+                break;
+            }
+            ++count;
         }
 
-        result ^= selected;
+        // If sizes don't match pad with zeros from the right
+        size_t size = result._elements.size();
+        for (size_t k = 0; k < count; ++k) {
+            size = max(size, block[k].size());
+        }
+        result._elements.resize(size);
+
+        // Add i-th element of this to the result wherever the i-th record has a one
+        parallel_for(size, [&](size_t begin, size_t end) {
+            for (size_t k = 0; k < count; ++k) {
+                const auto & record = block[k];
+                const auto & selector = _elements[first + k];
+
+                for (size_t j = begin; j < min(end, record.size()); ++j) {
+                    if (record[j]) {
+                        result._elements[j] += selector;
+                        context.reduce(result._elements[j], _lazy_reduction_bits);
+                    }
+                }
+            }
+        });
+
+        first += count;
     }
 
     return result;
 }
 
 const EncryptedArray
-EncryptedArray::select(const std::vector<EncryptedArray> & arrays) const noexcept
+EncryptedArray::select(const PlaintextDatabase & database) const
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
-    ASSERT(arrays.size() > 0, "Input array must not be empty");
+    ASSERT(_context, "EncryptedArray must be initialized");
+
+    const auto & context = reduction_context();
+
+    EncryptedArray result(_context, _max_degree, _degree);
+    result._lazy_reduction_bits = _lazy_reduction_bits;
+
+    const size_t n = min(_elements.size(), database.size());
+
+    // Sum of at most n elements of this
+    result._noise_bits = sum_noise(_noise_bits, n);
+    result._noise_limit_bits = _noise_limit_bits;
+    check_noise(result._noise_bits, result._noise_limit_bits);
+
+    result._elements.resize(database.record_size());
+    const size_t words = (n + 63) / 64;
+
+    // Records past the size of this array are masked out of the last word
+    const PlaintextDatabase::word_t last_word_mask =
+        (n % 64 == 0) ? ~PlaintextDatabase::word_t(0) : (PlaintextDatabase::word_t(1) << (n % 64)) - 1;
+
+    // Every output element is a scan of one column, zero words are skipped
+    parallel_for(database.record_size(), [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            const auto * column = database.column(j);
+            auto & element = result._elements[j];
+
+            for (size_t w = 0; w < words; ++w) {
+                auto word = column[w];
+                if (w + 1 == words) {
+                    word &= last_word_mask;
+                }
+
+                while (word != 0) {
+                    const size_t i = 64 * w + __builtin_ctzll(word);
+                    element += _elements[i];
+                    context.reduce(element, _lazy_reduction_bits);
+                    word &= word - 1;
+                }
+            }
+        }
+    });
 
-    const auto & public_element = *_public_element_ptr;
+    return result;
+}
 
-    EncryptedArray result(public_element, _max_degree);
+const EncryptedArray
+EncryptedArray::demux() const
+{
+    ASSERT(_context, "EncryptedArray must be initialized");
+    ASSERT(_elements.size() > 0, "Index must not be empty");
+    ASSERT(_elements.size() < 8 * sizeof(size_t), "Index is too large");
 
-    for (size_t i = 0; i < min(_elements.size(), arrays.size()); ++i) {
+    const auto & context = reduction_context();
 
-        EncryptedArray selected(public_element, _max_degree);
+    // Products of one factor b or b + 1 per element
+    const double noise = _elements.size() * add_noise(_noise_bits, 0);
+    check_noise(noise, _noise_limit_bits);
 
-        // Multiply i-th element of this by all of the elements in array
-        // The result will be decrypted to either original array or to array of zeros
-        for (const auto & selected_element : arrays[i]._elements) {
-            selected._elements.push_back((selected_element * _elements[i]) % public_element);
-        }
+    // Comparisons of the first bit with 0 and 1
+    vector<mpz_class> partial_products = {_elements.front() + 1, _elements.front()};
+    context.reduce(partial_products[0]);
+    context.reduce(partial_products[1]);
+
+    // Every partial product compares a prefix of this with all indexes that share it. Extend
+    // prefixes by one bit b at a time: p * b, and p * (b + 1) = p * b + p
+    for (size_t bit = 1; bit < _elements.size(); ++bit) {
+        vector<mpz_class> next_partial_products(2 * partial_products.size());
+
+        parallel_for(partial_products.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                auto & with_one = next_partial_products[2 * i + 1];
+                auto & with_zero = next_partial_products[2 * i];
 
-        selected._degree =  _degree + arrays[i]._degree;
+                with_one = partial_products[i];
+                multiply(with_one, _elements[bit], context);
 
-        result ^= selected;
+                with_zero = with_one + partial_products[i];
+                context.reduce(with_zero);
+            }
+        });
+
+        partial_products = std::move(next_partial_products);
     }
 
+    EncryptedArray result(_context, _max_degree, _degree * _elements.size());
+    result._lazy_reduction_bits = _lazy_reduction_bits;
+    result._elements = std::move(partial_products);
+    result._noise_bits = noise;
+    result._noise_limit_bits = _noise_limit_bits;
+
     return result;
 }
 
 EncryptedArray &
 EncryptedArray::extend(const EncryptedArray & other) noexcept
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
+    ASSERT(_context, "EncryptedArray must be initialized");
 
-    for (const auto & element : other._elements) {
-        _elements.push_back(element);
-    }
+    const size_t offset = _elements.size();
+    _elements.resize(offset + other._elements.size());
+
+    parallel_for(other._elements.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            _elements[offset + i] = other._elements[i];
+        }
+    });
 
     _degree = max(_degree, other._degree);
+    _noise_bits = max(_noise_bits, other._noise_bits);
+    _noise_limit_bits = max(_noise_limit_bits, other._noise_limit_bits);
+
+    return *this;
+}
+
+EncryptedArray &
+EncryptedArray::set_lazy_reduction(unsigned int headroom_bits) noexcept
+{
+    _lazy_reduction_bits = headroom_bits;
+
+    return *this;
+}
+
+double EncryptedArray::noise_budget() const noexcept
+{
+    if (_noise_limit_bits == 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return _noise_limit_bits - _noise_bits;
+}
+
+EncryptedArray &
+EncryptedArray::set_noise(double noise_bits, unsigned int noise_limit) noexcept
+{
+    _noise_bits = noise_bits;
+    _noise_limit_bits = noise_limit;
+
+    return *this;
+}
+
+EncryptedArray &
+EncryptedArray::normalize() noexcept
+{
+    ASSERT(_context, "EncryptedArray must be initialized");
+
+    const auto & context = reduction_context();
+
+    for (auto & element : _elements) {
+        context.reduce(element);
+    }
 
     return *this;
 }
@@ -386,9 +947,27 @@ EncryptedArray::extend(const EncryptedArray & other) noexcept
 const mpz_class &
 EncryptedArray::public_element() const noexcept
 {
-    ASSERT(_initialized, "EncryptedArray must be initialized");
+    ASSERT(_context, "EncryptedArray must be initialized");
+
+    return _context->public_element();
+}
+
+const ReductionContext &
+EncryptedArray::reduction_context() const noexcept
+{
+    ASSERT(_context, "EncryptedArray must be initialized");
+
+    return _context->reduction();
+}
+
+bool noise_check() noexcept
+{
+    return global_noise_check;
+}
 
-    return *_public_element_ptr;
+void set_noise_check(bool enabled) noexcept
+{
+    global_noise_check = enabled;
 }
 
 PlaintextArray
@@ -406,14 +985,15 @@ sum(const vector<PlaintextArray> & arrays) noexcept
 }
 
 EncryptedArray
-sum(const vector<EncryptedArray> & arrays) noexcept
+sum(const vector<EncryptedArray> & arrays)
 {
     ASSERT(arrays.size() > 0, "Input array must not be empty");
 
-    EncryptedArray result( arrays.front().public_element()
+    EncryptedArray result( arrays.front().context()
                          , arrays.front().max_degree()
                          , arrays.front().degree()
                          );
+    result.set_lazy_reduction(arrays.front().lazy_reduction());
 
     for (const auto & array : arrays) {
         result ^= array;
@@ -437,19 +1017,38 @@ product(const vector<PlaintextArray> & arrays) noexcept
 }
 
 EncryptedArray
-product(const vector<EncryptedArray> & arrays) noexcept
+product(const vector<EncryptedArray> & arrays)
 {
     ASSERT(arrays.size() > 0, "Input array must not be empty");
 
-    EncryptedArray result( arrays.front().public_element()
-                         , arrays.front().max_degree()
-                         , 0);
+    // Multiply arrays pairwise as a balanced binary tree, pairs of the same level in parallel
+    vector<EncryptedArray> partial_products((arrays.size() + 1) / 2);
 
-    for (const auto & array : arrays) {
-        result &= array;
+    parallel_for(partial_products.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            partial_products[i] = arrays[2 * i];
+            if (2 * i + 1 < arrays.size()) {
+                partial_products[i] &= arrays[2 * i + 1];
+            }
+        }
+    });
+
+    while (partial_products.size() > 1) {
+        vector<EncryptedArray> next_partial_products((partial_products.size() + 1) / 2);
+
+        parallel_for(next_partial_products.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                next_partial_products[i] = std::move(partial_products[2 * i]);
+                if (2 * i + 1 < partial_products.size()) {
+                    next_partial_products[i] &= partial_products[2 * i + 1];
+                }
+            }
+        });
+
+        partial_products = std::move(next_partial_products);
     }
 
-    return result;
+    return partial_products.front();
 }
 
 PlaintextArray
@@ -471,7 +1070,7 @@ concat(const vector<EncryptedArray> & arrays) noexcept
 {
     ASSERT(arrays.size() > 0, "Input array must not be empty");
 
-    EncryptedArray result( arrays.front().public_element()
+    EncryptedArray result( arrays.front().context()
                          , arrays.front().max_degree()
                          , arrays.front().degree()
                          );
@@ -492,7 +1091,9 @@ CompressedCiphertext::CompressedCiphertext(const ParameterSet & params) noexcept
 void CompressedCiphertext::initialize_prf_stream() const noexcept
 {
     _prf_stream.reset(
-        new PseudoRandomStream{_parameter_set.ciphertext_size_bits, _parameter_set.prf_seed});
+        new PseudoRandomStream{ _parameter_set.ciphertext_size_bits
+                              , _parameter_set.prf_seed
+                              , _parameter_set.prf_mode });
 }
 
 bool CompressedCiphertext::operator==(const CompressedCiphertext & other) const noexcept
@@ -502,20 +1103,61 @@ bool CompressedCiphertext::operator==(const CompressedCiphertext & other) const
         && (_elements_deltas == other._elements_deltas);
 }
 
-EncryptedArray CompressedCiphertext::expand() const noexcept
+EncryptedArray CompressedCiphertext::expand() const
+{
+    vector<size_t> indexes(_elements_deltas.size());
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        indexes[i] = i;
+    }
+
+    return expand(indexes);
+}
+
+EncryptedArray CompressedCiphertext::expand(const std::vector<size_t> & indexes) const
 {
+    for (const auto index : indexes) {
+        ASSERT(index < _elements_deltas.size(), "Index out of range");
+    }
+
     _prf_stream->reset();
 
-    // Restore public element
+    // Restore public element, its context is looked up once per ciphertext
     const auto & prf_output = _prf_stream->next();
-    const auto public_element = prf_output - _public_element_delta;
+    if (!_context) {
+        _context = EvaluationContext::get(prf_output - _public_element_delta);
+    }
 
-    EncryptedArray result(public_element, _parameter_set.degree());
+    EncryptedArray result(_context, _parameter_set.degree());
+    result._elements.resize(indexes.size());
+
+    // Noise must stay below the private element, which has its top bit set
+    result._noise_bits = _parameter_set.fresh_noise_bits();
+    result._noise_limit_bits = _parameter_set.noise_limit_bits();
 
     // Restore ciphertext elements
-    for (const auto & delta : _elements_deltas) {
-        const auto & prf_output = _prf_stream->next();
-        result._elements.push_back(prf_output - delta);
+    if (_prf_stream->random_access()) {
+        // Counter mode outputs are computed directly, in parallel
+        parallel_for(indexes.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const auto index = indexes[i];
+                result._elements[i] = _prf_stream->at(index + 1) - _elements_deltas[index];
+            }
+        });
+    } else {
+        // Stream mode outputs come in order, every one up to the last requested index is generated
+        vector<vector<size_t>> positions(_elements_deltas.size());
+        size_t last_index = 0;
+        for (size_t i = 0; i < indexes.size(); ++i) {
+            positions[indexes[i]].push_back(i);
+            last_index = max(last_index, indexes[i] + 1);
+        }
+
+        for (size_t index = 0; index < last_index; ++index) {
+            const auto & prf_output = _prf_stream->next();
+            for (const auto i : positions[index]) {
+                result._elements[i] = prf_output - _elements_deltas[index];
+            }
+        }
     }
 
     return result;
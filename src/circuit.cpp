@@ -0,0 +1,630 @@
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
+
+#include "she/circuit.hpp"
+#include "she/exceptions.hpp"
+#include "she/parallel.hpp"
+
+using std::max;
+using std::min;
+using std::pair;
+using std::vector;
+
+
+namespace she
+{
+
+namespace
+{
+
+using Operation = Circuit::Operation;
+
+// Whether all bits of the array equal `value`
+bool all_bits(const PlaintextArray & array, bool value) noexcept
+{
+    const PlaintextArray::word_t full = value ? ~PlaintextArray::word_t(0) : 0;
+
+    const size_t full_words = array.size() / 64;
+    for (size_t w = 0; w < full_words; ++w) {
+        if (array.words()[w] != full) {
+            return false;
+        }
+    }
+
+    if (array.size() % 64 != 0) {
+        const auto mask = (PlaintextArray::word_t(1) << (array.size() % 64)) - 1;
+        return array.words()[full_words] == (full & mask);
+    }
+    return true;
+}
+
+unsigned int ceil_log2(size_t value) noexcept
+{
+    unsigned int result = 0;
+    while ((size_t(1) << result) < value) {
+        ++result;
+    }
+    return result;
+}
+
+} // namespace
+
+
+Expression & Expression::operator^=(const Expression & other)
+{
+    ASSERT(_circuit, "Expression must be initialized");
+    ASSERT(_circuit == other._circuit, "Expressions must belong to the same circuit");
+
+    _node = _circuit->record(Operation::add, {_node, other._node});
+
+    return *this;
+}
+
+Expression & Expression::operator^=(const PlaintextArray & other)
+{
+    ASSERT(_circuit, "Expression must be initialized");
+
+    _node = _circuit->record(Operation::add, {_node, _circuit->record_constant(other)});
+
+    return *this;
+}
+
+Expression & Expression::operator&=(const Expression & other)
+{
+    ASSERT(_circuit, "Expression must be initialized");
+    ASSERT(_circuit == other._circuit, "Expressions must belong to the same circuit");
+
+    _node = _circuit->record(Operation::multiply, {_node, other._node});
+
+    return *this;
+}
+
+Expression & Expression::operator&=(const PlaintextArray & other)
+{
+    ASSERT(_circuit, "Expression must be initialized");
+
+    _node = _circuit->record(Operation::multiply, {_node, _circuit->record_constant(other)});
+
+    return *this;
+}
+
+const Expression Expression::equal(const vector<Expression> & arrays) const
+{
+    ASSERT(_circuit, "Expression must be initialized");
+    ASSERT(arrays.size() > 0, "Input array must not be empty");
+
+    vector<size_t> operands = {_node};
+    for (const auto & array : arrays) {
+        ASSERT(_circuit == array._circuit, "Expressions must belong to the same circuit");
+        operands.push_back(array._node);
+    }
+
+    return _circuit->expression(_circuit->record(Operation::equal, std::move(operands)));
+}
+
+const Expression Expression::select(const vector<Expression> & arrays) const
+{
+    ASSERT(_circuit, "Expression must be initialized");
+    ASSERT(arrays.size() > 0, "Input array must not be empty");
+
+    vector<size_t> operands = {_node};
+    for (const auto & array : arrays) {
+        ASSERT(_circuit == array._circuit, "Expressions must belong to the same circuit");
+        operands.push_back(array._node);
+    }
+
+    return _circuit->expression(_circuit->record(Operation::select, std::move(operands)));
+}
+
+size_t Expression::size() const
+{
+    ASSERT(_circuit, "Expression must be initialized");
+
+    return _circuit->_nodes[_node].size;
+}
+
+
+Expression Circuit::input(EncryptedArray array)
+{
+    ASSERT(array.context(), "EncryptedArray must be initialized");
+
+    Node node;
+    node.operation = Operation::input;
+    node.size = array.size();
+    node.depth = 0;
+    node.input = std::make_shared<const EncryptedArray>(std::move(array));
+    _nodes.push_back(std::move(node));
+
+    return expression(_nodes.size() - 1);
+}
+
+Expression Circuit::constant(PlaintextArray array) noexcept
+{
+    return expression(record_constant(std::move(array)));
+}
+
+unsigned int Circuit::depth(const Expression & expression) const
+{
+    ASSERT(expression._circuit == this, "Expression must belong to the circuit");
+
+    return _nodes[expression._node].depth;
+}
+
+size_t Circuit::record_constant(PlaintextArray array) noexcept
+{
+    auto key = std::make_pair(array.size(), vector<PlaintextArray::word_t>(array.words(), array.words() + array.word_count()));
+
+    const auto position = _constants.find(key);
+    if (position != _constants.end()) {
+        return position->second;
+    }
+
+    Node node;
+    node.operation = Operation::constant;
+    node.size = array.size();
+    node.depth = 0;
+    node.constant = std::make_shared<const PlaintextArray>(std::move(array));
+    _nodes.push_back(std::move(node));
+
+    _constants.emplace(std::move(key), _nodes.size() - 1);
+    return _nodes.size() - 1;
+}
+
+size_t Circuit::record(Operation operation, vector<size_t> operands) noexcept
+{
+    // Addition and multiplication do not depend on the order of operands
+    if (operation == Operation::add || operation == Operation::multiply) {
+        std::sort(operands.begin(), operands.end());
+    }
+
+    // Fold operations on constants only
+    const bool constant_operands = std::all_of(operands.begin(), operands.end(), [&](size_t operand) {
+        return constant_value(operand) != nullptr;
+    });
+
+    if (constant_operands) {
+        const auto & first = *constant_value(operands[0]);
+
+        vector<PlaintextArray> arrays;
+        for (size_t i = 1; i < operands.size(); ++i) {
+            arrays.push_back(*constant_value(operands[i]));
+        }
+
+        switch (operation) {
+            case Operation::add:
+                return record_constant(first ^ arrays[0]);
+            case Operation::multiply:
+                return record_constant(first & arrays[0]);
+            case Operation::equal:
+                return record_constant(first.equal(arrays));
+            case Operation::select:
+                return record_constant(first.select(arrays));
+            default:
+                break;
+        }
+    }
+
+    // Fold additions and multiplications that do not change or do not depend on the operand
+    if (operation == Operation::add || operation == Operation::multiply) {
+        const size_t a = operands[0];
+        const size_t b = operands[1];
+
+        if (a == b) {
+            if (operation == Operation::multiply) {
+                return a;
+            }
+            return record_constant(PlaintextArray().resize(_nodes[a].size));
+        }
+
+        for (const auto & pair : {std::make_pair(a, b), std::make_pair(b, a)}) {
+            const auto * value = constant_value(pair.first);
+            const size_t other = pair.second;
+            if (value == nullptr) {
+                continue;
+            }
+
+            // Padding keeps the elements of the longer operand
+            if (operation == Operation::add && all_bits(*value, 0) && value->size() <= _nodes[other].size) {
+                return other;
+            }
+            if (operation == Operation::multiply && all_bits(*value, 1) && value->size() <= _nodes[other].size) {
+                return other;
+            }
+            if (operation == Operation::multiply && all_bits(*value, 0) && value->size() >= _nodes[other].size) {
+                return pair.first;
+            }
+        }
+    }
+
+    auto key = std::make_pair(operation, operands);
+
+    const auto position = _index.find(key);
+    if (position != _index.end()) {
+        return position->second;
+    }
+
+    Node node;
+    node.operation = operation;
+    node.size = result_size(operation, operands);
+    node.depth = result_depth(operation, operands);
+    node.operands = std::move(operands);
+    _nodes.push_back(std::move(node));
+
+    _index.emplace(std::move(key), _nodes.size() - 1);
+    return _nodes.size() - 1;
+}
+
+const PlaintextArray * Circuit::constant_value(size_t node) const noexcept
+{
+    return (_nodes[node].operation == Operation::constant) ? _nodes[node].constant.get() : nullptr;
+}
+
+size_t Circuit::result_size(Operation operation, const vector<size_t> & operands) const noexcept
+{
+    size_t size = 0;
+
+    switch (operation) {
+        case Operation::add:
+        case Operation::multiply:
+            size = max(_nodes[operands[0]].size, _nodes[operands[1]].size);
+            break;
+        case Operation::equal:
+            size = operands.size() - 1;
+            break;
+        case Operation::select:
+            for (size_t i = 1; i < min(operands.size(), _nodes[operands[0]].size + 1); ++i) {
+                size = max(size, _nodes[operands[i]].size);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return size;
+}
+
+unsigned int Circuit::result_depth(Operation operation, const vector<size_t> & operands) const noexcept
+{
+    unsigned int depth = 0;
+    bool constant_operand = false;
+    bool constant_arrays = true;
+    size_t size = 0;
+
+    for (size_t i = 0; i < operands.size(); ++i) {
+        const auto & node = _nodes[operands[i]];
+        depth = max(depth, node.depth);
+        size = max(size, node.size);
+        constant_operand = constant_operand || node.operation == Operation::constant;
+        if (i > 0) {
+            constant_arrays = constant_arrays && node.operation == Operation::constant;
+        }
+    }
+
+    switch (operation) {
+        case Operation::multiply:
+            return constant_operand ? depth : depth + 1;
+        case Operation::equal:
+            // Product of all elements of the difference as a balanced binary tree
+            return depth + ceil_log2(size);
+        case Operation::select:
+            // Additions only if either side is known
+            return (_nodes[operands[0]].operation == Operation::constant || constant_arrays) ? depth : depth + 1;
+        default:
+            return depth;
+    }
+}
+
+vector<size_t> Circuit::schedule(const vector<Expression> & outputs) const
+{
+    vector<size_t> order;
+    vector<bool> visited(_nodes.size(), false);
+
+    // Depth-first traversal with an explicit stack of nodes and their next operand
+    vector<pair<size_t, size_t>> stack;
+    for (const auto & output : outputs) {
+        ASSERT(output._circuit == this, "Expression must belong to the circuit");
+
+        if (visited[output._node]) {
+            continue;
+        }
+        visited[output._node] = true;
+        stack.emplace_back(output._node, 0);
+
+        while (!stack.empty()) {
+            const size_t node = stack.back().first;
+            const size_t next = stack.back().second;
+
+            if (next < _nodes[node].operands.size()) {
+                ++stack.back().second;
+
+                const size_t operand = _nodes[node].operands[next];
+                if (!visited[operand]) {
+                    visited[operand] = true;
+                    stack.emplace_back(operand, 0);
+                }
+            } else {
+                order.push_back(node);
+                stack.pop_back();
+            }
+        }
+    }
+
+    return order;
+}
+
+vector<size_t> Circuit::references(const vector<size_t> & order, const vector<Expression> & outputs) const noexcept
+{
+    vector<size_t> result(_nodes.size(), 0);
+
+    for (const auto node : order) {
+        for (const auto operand : _nodes[node].operands) {
+            ++result[operand];
+        }
+    }
+    for (const auto & output : outputs) {
+        ++result[output._node];
+    }
+
+    return result;
+}
+
+void Circuit::optimize(const vector<Expression> & outputs)
+{
+    const auto order = schedule(outputs);
+    const auto counts = references(order, outputs);
+
+    // A multiplication used once, by another multiplication, is part of that one's chain
+    vector<size_t> multiplication_counts(_nodes.size(), 0);
+    for (const auto node : order) {
+        if (_nodes[node].operation == Operation::multiply) {
+            for (const auto operand : _nodes[node].operands) {
+                ++multiplication_counts[operand];
+            }
+        }
+    }
+
+    const auto in_chain = [&](size_t node) {
+        return node < counts.size() && _nodes[node].operation == Operation::multiply
+            && counts[node] == 1 && multiplication_counts[node] == 1;
+    };
+
+    for (const auto node : order) {
+        if (_nodes[node].operation == Operation::multiply && !in_chain(node)) {
+
+            // Factors of the chain that ends in this node
+            vector<size_t> factors;
+            vector<size_t> stack(_nodes[node].operands);
+            while (!stack.empty()) {
+                const size_t operand = stack.back();
+                stack.pop_back();
+
+                if (in_chain(operand)) {
+                    stack.insert(stack.end(), _nodes[operand].operands.begin(), _nodes[operand].operands.end());
+                } else {
+                    factors.push_back(operand);
+                }
+            }
+
+            // Multiplication is idempotent, repeated factors are dropped
+            std::sort(factors.begin(), factors.end());
+            factors.erase(std::unique(factors.begin(), factors.end()), factors.end());
+
+            if (factors.size() > 2) {
+                // Multiply the two shallowest factors first
+                using Factor = pair<unsigned int, size_t>;
+                std::priority_queue<Factor, vector<Factor>, std::greater<Factor>> queue;
+                for (const auto factor : factors) {
+                    queue.emplace(_nodes[factor].depth, factor);
+                }
+
+                while (queue.size() > 2) {
+                    const size_t a = queue.top().second;
+                    queue.pop();
+                    const size_t b = queue.top().second;
+                    queue.pop();
+
+                    const size_t product = record(Operation::multiply, {a, b});
+                    queue.emplace(_nodes[product].depth, product);
+                }
+
+                const size_t a = queue.top().second;
+                queue.pop();
+                const size_t b = queue.top().second;
+
+                // The node keeps its index, so its users stay valid. It is found under its new
+                // operands from now on
+                const auto old_key = std::make_pair(Operation::multiply, _nodes[node].operands);
+                const auto position = _index.find(old_key);
+                if (position != _index.end() && position->second == node) {
+                    _index.erase(position);
+                }
+
+                _nodes[node].operands = {min(a, b), max(a, b)};
+                _index.emplace(std::make_pair(Operation::multiply, _nodes[node].operands), node);
+            }
+        }
+
+        // Operands come first, so their depths are already updated
+        _nodes[node].depth = (_nodes[node].operands.empty())
+            ? _nodes[node].depth
+            : result_depth(_nodes[node].operation, _nodes[node].operands);
+    }
+}
+
+EncryptedArray Circuit::evaluate(const Expression & output)
+{
+    return evaluate(vector<Expression>{output}).front();
+}
+
+vector<EncryptedArray> Circuit::evaluate(const vector<Expression> & outputs)
+{
+    optimize(outputs);
+
+    const auto order = schedule(outputs);
+    const auto counts = references(order, outputs);
+
+    // Operations run as tasks once their operands are computed
+    TaskGraph graph;
+    vector<size_t> tasks;
+    vector<size_t> task_of(_nodes.size(), 0);
+    for (const auto node : order) {
+        const auto & operation = _nodes[node].operation;
+        if (operation == Operation::input || operation == Operation::constant) {
+            continue;
+        }
+
+        task_of[node] = tasks.size();
+        tasks.push_back(node);
+        graph.successors.emplace_back();
+        graph.dependencies.push_back(0);
+
+        for (const auto operand : _nodes[node].operands) {
+            const auto & operand_operation = _nodes[operand].operation;
+            if (operand_operation != Operation::input && operand_operation != Operation::constant) {
+                graph.successors[task_of[operand]].push_back(task_of[node]);
+                ++graph.dependencies.back();
+            }
+        }
+    }
+
+    // References not yet used. An operation drops its references once it is done
+    vector<std::atomic<size_t>> remaining(_nodes.size());
+    for (size_t node = 0; node < _nodes.size(); ++node) {
+        remaining[node] = counts[node];
+    }
+
+    std::atomic<size_t> live(0);
+    std::atomic<size_t> peak(0);
+
+    // Constants become trivial encryptions under the context of the first input
+    const EncryptedArray * reference = nullptr;
+    for (const auto & node : _nodes) {
+        if (node.operation == Operation::input) {
+            reference = node.input.get();
+            break;
+        }
+    }
+
+    const auto lift = [&](const PlaintextArray & array) {
+        ASSERT(reference, "Circuit must have an input");
+
+        EncryptedArray result(reference->context(), reference->max_degree(), 0);
+        result ^= array;
+        return result;
+    };
+
+    vector<EncryptedArray> values(_nodes.size());
+
+    const auto value = [&](size_t node) -> const EncryptedArray & {
+        return (_nodes[node].operation == Operation::input) ? *_nodes[node].input : values[node];
+    };
+
+    // Intermediate values are moved into the operation that uses them last. Other operations
+    // that use the value hold references until they are done, so no one else reads it
+    const auto movable = [&](size_t node) {
+        return _nodes[node].operation != Operation::input && remaining[node] == 1;
+    };
+
+    const auto take = [&](size_t node) -> EncryptedArray {
+        if (const auto * constant = constant_value(node)) {
+            return lift(*constant);
+        }
+        if (movable(node)) {
+            return std::move(values[node]);
+        }
+        return value(node);
+    };
+
+    // Intermediate values are freed as soon as their last user is done
+    const auto release = [&](size_t node) {
+        const auto & operation = _nodes[node].operation;
+        if (--remaining[node] == 0 && operation != Operation::input && operation != Operation::constant) {
+            vector<mpz_class>().swap(values[node].elements());
+            --live;
+        }
+    };
+
+    run(graph, [&](size_t task) {
+        const size_t node = tasks[task];
+        const auto & operation = _nodes[node].operation;
+        const auto & operands = _nodes[node].operands;
+
+        EncryptedArray result;
+
+        if (operation == Operation::add || operation == Operation::multiply) {
+            size_t a = operands[0];
+            size_t b = operands[1];
+
+            // At most one operand is constant, it is applied as a plaintext
+            if (constant_value(a) != nullptr || (movable(b) && !movable(a))) {
+                std::swap(a, b);
+            }
+
+            result = take(a);
+
+            const auto * constant = constant_value(b);
+            if (operation == Operation::add) {
+                constant ? (result ^= *constant) : (result ^= value(b));
+            } else {
+                constant ? (result &= *constant) : (result &= value(b));
+            }
+        } else {
+            const size_t first = operands[0];
+            const auto * first_constant = constant_value(first);
+
+            bool constant_arrays = true;
+            for (size_t i = 1; i < operands.size(); ++i) {
+                constant_arrays = constant_arrays && constant_value(operands[i]) != nullptr;
+            }
+
+            if (constant_arrays) {
+                vector<PlaintextArray> arrays;
+                for (size_t i = 1; i < operands.size(); ++i) {
+                    arrays.push_back(*constant_value(operands[i]));
+                }
+
+                result = (operation == Operation::equal)
+                    ? value(first).equal(arrays)
+                    : value(first).select(arrays);
+            } else {
+                vector<EncryptedArray> arrays;
+                for (size_t i = 1; i < operands.size(); ++i) {
+                    arrays.push_back(take(operands[i]));
+                }
+
+                if (first_constant != nullptr) {
+                    result = (operation == Operation::equal)
+                        ? first_constant->equal(arrays)
+                        : first_constant->select(arrays);
+                } else {
+                    result = (operation == Operation::equal)
+                        ? value(first).equal(arrays)
+                        : value(first).select(arrays);
+                }
+            }
+        }
+
+        for (const auto operand : operands) {
+            release(operand);
+        }
+        values[node] = std::move(result);
+
+        const size_t now = ++live;
+        size_t highest = peak;
+        while (now > highest && !peak.compare_exchange_weak(highest, now)) {}
+    });
+
+    _peak_values = peak;
+
+    vector<EncryptedArray> results;
+    for (const auto & output : outputs) {
+        results.push_back(take(output._node));
+        release(output._node);
+    }
+
+    return results;
+}
+
+} // namespace she
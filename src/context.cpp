@@ -0,0 +1,72 @@
+#include <map>
+#include <mutex>
+
+#include "she/context.hpp"
+
+using std::lock_guard;
+using std::map;
+using std::mutex;
+using std::shared_ptr;
+using std::weak_ptr;
+
+
+namespace she
+{
+
+namespace
+{
+
+struct ContextRegistry
+{
+    mutex registry_mutex;
+    map<mpz_class, weak_ptr<const EvaluationContext>> contexts;
+};
+
+// Never destroyed, contexts may outlive static destruction
+ContextRegistry & registry() noexcept
+{
+    static ContextRegistry * instance = new ContextRegistry;
+    return *instance;
+}
+
+} // namespace
+
+
+EvaluationContext::EvaluationContext(const mpz_class & public_element) :
+  _reduction(public_element)
+{}
+
+shared_ptr<const EvaluationContext> EvaluationContext::get(const mpz_class & public_element)
+{
+    auto & shared = registry();
+    lock_guard<mutex> lock(shared.registry_mutex);
+
+    const auto it = shared.contexts.find(public_element);
+    if (it != shared.contexts.end()) {
+        const auto context = it->second.lock();
+        if (context) {
+            return context;
+        }
+    }
+
+    // Last owner removes the entry, unless it has been replaced by a live context meanwhile
+    const shared_ptr<const EvaluationContext> context(
+        new EvaluationContext(public_element),
+        [](const EvaluationContext * released) {
+            {
+                auto & shared = registry();
+                lock_guard<mutex> lock(shared.registry_mutex);
+
+                const auto it = shared.contexts.find(released->public_element());
+                if (it != shared.contexts.end() && it->second.expired()) {
+                    shared.contexts.erase(it);
+                }
+            }
+            delete released;
+        });
+
+    shared.contexts[public_element] = context;
+    return context;
+}
+
+} // namespace she
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "she/database.hpp"
+#include "she/exceptions.hpp"
+
+using std::string;
+using std::vector;
+
+
+namespace she
+{
+
+namespace
+{
+
+const char DATABASE_MAGIC[8] = {'S', 'H', 'E', 'R', 'E', 'C', 'S', '1'};
+
+size_t record_bytes(size_t record_size) noexcept
+{
+    return (record_size + 7) / 8;
+}
+
+} // namespace
+
+
+bool VectorRecordSource::next(PlaintextArray & record)
+{
+    if (_position == _records.size()) {
+        return false;
+    }
+
+    record = _records[_position++];
+    return true;
+}
+
+
+void PackedRecordFile::write(const string & path, RecordSource & records, size_t record_size)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    ASSERT(file, "Cannot create record file " << path);
+
+    Header header;
+    std::memcpy(header.magic, DATABASE_MAGIC, sizeof(header.magic));
+    header.count = 0;
+    header.record_size = record_size;
+
+    // Header is rewritten once the number of records is known
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    PlaintextArray record;
+    vector<unsigned char> packed(record_bytes(record_size));
+    while (records.next(record)) {
+        ASSERT(record.size() <= record_size, "Record is larger than the record size");
+
+        // Bytes of the packed words, least significant first
+        std::fill(packed.begin(), packed.end(), 0);
+        for (size_t b = 0; b < record_bytes(record.size()); ++b) {
+            packed[b] = static_cast<unsigned char>(record.words()[b / 8] >> (8 * (b % 8)));
+        }
+
+        file.write(reinterpret_cast<const char *>(packed.data()), packed.size());
+        ++header.count;
+    }
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.close();
+    ASSERT(file, "Cannot write record file " << path);
+}
+
+PackedRecordFile::PackedRecordFile(const string & path) :
+  _mapping(MAP_FAILED),
+  _mapping_size(0),
+  _records(nullptr),
+  _position(0)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    ASSERT(fd >= 0, "Cannot open record file " << path);
+
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        _mapping_size = status.st_size;
+        _mapping = mmap(nullptr, _mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    ASSERT(_mapping != MAP_FAILED, "Cannot map record file " << path);
+
+    if (_mapping_size >= sizeof(Header)) {
+        std::memcpy(&_header, _mapping, sizeof(Header));
+    } else {
+        std::memset(&_header, 0, sizeof(Header));
+    }
+
+    // Sizes come from the file. The record size is bounded by the data before it is rounded up,
+    // and the count is compared by division, so nothing can wrap
+    const uint64_t data_bytes = (_mapping_size >= sizeof(Header)) ? _mapping_size - sizeof(Header) : 0;
+    const bool valid_record_size = _header.record_size / 8 <= data_bytes;
+    const uint64_t bytes = valid_record_size ? record_bytes(_header.record_size) : 0;
+
+    const bool valid =
+        _mapping_size >= sizeof(Header)
+        && std::memcmp(_header.magic, DATABASE_MAGIC, sizeof(DATABASE_MAGIC)) == 0
+        && (valid_record_size || _header.count == 0)
+        && ((bytes == 0) ? data_bytes == 0 : (data_bytes % bytes == 0 && _header.count == data_bytes / bytes));
+
+    if (!valid) {
+        munmap(_mapping, _mapping_size);
+        _mapping = MAP_FAILED;
+    }
+    ASSERT(valid, "Invalid record file " << path);
+
+    // Records are read in one pass
+    madvise(_mapping, _mapping_size, MADV_SEQUENTIAL);
+
+    _records = static_cast<const unsigned char *>(_mapping) + sizeof(Header);
+}
+
+PackedRecordFile::~PackedRecordFile() noexcept
+{
+    if (_mapping != MAP_FAILED) {
+        munmap(_mapping, _mapping_size);
+    }
+}
+
+bool PackedRecordFile::next(PlaintextArray & record)
+{
+    if (_position == _header.count) {
+        return false;
+    }
+
+    const auto * packed = _records + _position * record_bytes(_header.record_size);
+
+    vector<PlaintextArray::word_t> words((_header.record_size + 63) / 64, 0);
+    for (size_t b = 0; b < record_bytes(_header.record_size); ++b) {
+        words[b / 8] |= PlaintextArray::word_t(packed[b]) << (8 * (b % 8));
+    }
+    record = PlaintextArray(std::move(words), _header.record_size);
+
+    ++_position;
+    return true;
+}
+
+
+PlaintextDatabase::PlaintextDatabase(const vector<PlaintextArray> & records) :
+  _size(0)
+{
+    VectorRecordSource source(records);
+    append(source);
+}
+
+PlaintextDatabase::PlaintextDatabase(RecordSource & records) :
+  _size(0)
+{
+    append(records);
+}
+
+void PlaintextDatabase::append(RecordSource & records)
+{
+    PlaintextArray record;
+    while (records.next(record)) {
+        const size_t word = _size / 64;
+        const word_t mask = word_t(1) << (_size % 64);
+
+        // Columns of a longer record start with zeros for all previous records
+        if (record.size() > _columns.size()) {
+            _columns.resize(record.size(), vector<word_t>(column_words(), 0));
+        }
+
+        // Start a new word in every column
+        if (mask == 1) {
+            for (auto & column : _columns) {
+                column.push_back(0);
+            }
+        }
+
+        // Set the bit of the record in the columns of its ones
+        const auto * words = record.words();
+        for (size_t w = 0; w < record.word_count(); ++w) {
+            auto bits = words[w];
+            while (bits != 0) {
+                _columns[64 * w + __builtin_ctzll(bits)][word] |= mask;
+                bits &= bits - 1;
+            }
+        }
+
+        ++_size;
+    }
+}
+
+PlaintextArray PlaintextDatabase::record(size_t index) const
+{
+    ASSERT(index < _size, "Index out of range");
+
+    PlaintextArray result;
+    result.resize(_columns.size());
+    for (size_t j = 0; j < _columns.size(); ++j) {
+        result.set(j, (_columns[j][index / 64] >> (index % 64)) & 1);
+    }
+
+    return result;
+}
+
+} // namespace she
@@ -1,4 +1,5 @@
 #include <cassert>
+#include <cmath>
 #include <random>
 
 #include <iostream>
@@ -8,6 +9,7 @@ using std::endl;
 #include "she.hpp"
 #include "she/defs.hpp"
 #include "she/exceptions.hpp"
+#include "she/parallel.hpp"
 
 using std::random_device;
 using std::vector;
@@ -19,12 +21,14 @@ namespace she
                                unsigned int rho,
                                unsigned int eta,
                                unsigned int gamma,
-                               unsigned int seed) :
+                               unsigned int seed,
+                               PRFMode mode) :
       security(lambda),
       noise_size_bits(rho),
       private_key_size_bits(eta),
       ciphertext_size_bits(gamma),
-      prf_seed(seed)
+      prf_seed(seed),
+      prf_mode(mode)
     {
         ASSERT((gamma >= eta) && (eta >= rho) && (rho > 0), "Bad parameters");
     }
@@ -34,11 +38,13 @@ namespace she
       noise_size_bits(1),
       private_key_size_bits(1),
       ciphertext_size_bits(1),
-      prf_seed(1)
+      prf_seed(1),
+      prf_mode(PRFMode::stream)
     {}
 
     const ParameterSet
-    ParameterSet::generate_parameter_set(unsigned int security, unsigned int circuit_mult_size, unsigned int seed)
+    ParameterSet::generate_parameter_set(unsigned int security, unsigned int circuit_mult_size, unsigned int seed,
+                                         PRFMode prf_mode)
     {
         ASSERT(security > 0, "Security parameter should be greater than 0");
         ASSERT(circuit_mult_size > 0, "Multiplicative circuit size should be greater than 0");
@@ -47,7 +53,13 @@ namespace she
                      eta = security * security + security * circuit_mult_size,
                      gamma = eta * eta * circuit_mult_size;
 
-        return { security, rho, eta, gamma, seed };
+        return { security, rho, eta, gamma, seed, prf_mode };
+    }
+
+    double ParameterSet::fresh_noise_bits() const noexcept
+    {
+        // Noise 2r + m with r in [1, 2^rho] is at most 2^(rho + 1) + 1
+        return std::log2(std::exp2(noise_size_bits + 1.0) + 1);
     }
 
     bool ParameterSet::operator==(const ParameterSet& other) const
@@ -57,7 +69,8 @@ namespace she
             && (noise_size_bits == other.noise_size_bits)
             && (private_key_size_bits == other.private_key_size_bits)
             && (ciphertext_size_bits == other.ciphertext_size_bits)
-            && (prf_seed == other.prf_seed);
+            && (prf_seed == other.prf_seed)
+            && (prf_mode == other.prf_mode);
     }
 
 
@@ -76,10 +89,12 @@ namespace she
 
     PrivateKey& PrivateKey::generate_values() noexcept
     {
-        // Generate odd eta-bit integer
+        // Generate odd eta-bit integer. The top bit is set, so that noise below 2^(eta - 1)
+        // always decrypts correctly
         do {
             _private_element = _generator->get_bits(_parameter_set.private_key_size_bits);
         } while (_private_element % 2 == 0);
+        mpz_setbit(_private_element.get_mpz_t(), _parameter_set.private_key_size_bits - 1);
 
         // Generate random odd q from [1, 2^gamma / p)
         const mpz_class q_upper_bound = (mpz_class(1) << _parameter_set.ciphertext_size_bits)
@@ -96,7 +111,9 @@ namespace she
     {
         _generator.reset(new CSPRNG);
         _prf_stream.reset(
-            new PseudoRandomStream{_parameter_set.ciphertext_size_bits, _parameter_set.prf_seed});
+            new PseudoRandomStream{ _parameter_set.ciphertext_size_bits
+                                  , _parameter_set.prf_seed
+                                  , _parameter_set.prf_mode });
     }
 
     CompressedCiphertext PrivateKey::encrypt(const std::vector<bool> & bits) const noexcept
@@ -109,16 +126,29 @@ namespace she
         const mpz_class & prf_output = _prf_stream->next();
         result._public_element_delta = prf_output % _private_element;
 
-        for (const bool m : bits)
-        {
-            // Choose random noise
-            const mpz_class r = _generator->get_range_bits(_parameter_set.noise_size_bits) + 1;
-
-            // Random PRF output
-            const mpz_class & prf_output = _prf_stream->next();
+        // Choose random noises
+        vector<mpz_class> noises;
+        for (size_t i = 0; i < bits.size(); ++i) {
+            noises.push_back(_generator->get_range_bits(_parameter_set.noise_size_bits) + 1);
+        }
 
-            // Add compressed ciphertext deltas
-            result._elements_deltas.push_back((prf_output - 2*r - m) % _private_element);
+        // Add compressed ciphertext deltas
+        result._elements_deltas.resize(bits.size());
+        auto compress = [&](size_t i, const mpz_class & prf_output) {
+            result._elements_deltas[i] = (prf_output - 2*noises[i] - bits[i]) % _private_element;
+        };
+
+        if (_prf_stream->random_access()) {
+            // Counter mode outputs are independent, compress elements in parallel
+            parallel_for(bits.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    compress(i, _prf_stream->at(i + 1));
+                }
+            });
+        } else {
+            for (size_t i = 0; i < bits.size(); ++i) {
+                compress(i, _prf_stream->next());
+            }
         }
 
         return result;
@@ -0,0 +1,492 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "she/parallel.hpp"
+
+using std::atomic;
+using std::exception_ptr;
+using std::lock_guard;
+using std::min;
+using std::mutex;
+using std::shared_ptr;
+using std::unique_lock;
+using std::vector;
+
+
+namespace she
+{
+
+namespace
+{
+
+// Pool and queue of the current thread, if it is a worker of a work-stealing pool
+thread_local const WorkStealingPool * current_pool = nullptr;
+thread_local size_t current_pool_queue = 0;
+
+} // namespace
+
+
+void Executor::run(const TaskGraph & graph, const TaskBody & body)
+{
+    vector<size_t> waiting(graph.dependencies);
+
+    vector<size_t> ready;
+    for (size_t task = 0; task < graph.size(); ++task) {
+        if (waiting[task] == 0) {
+            ready.push_back(task);
+        }
+    }
+
+    while (!ready.empty()) {
+        parallel_for(ready.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                body(ready[i]);
+            }
+        });
+
+        vector<size_t> next;
+        for (const auto task : ready) {
+            for (const auto successor : graph.successors[task]) {
+                if (--waiting[successor] == 0) {
+                    next.push_back(successor);
+                }
+            }
+        }
+        ready = std::move(next);
+    }
+}
+
+
+void SerialExecutor::parallel_for(size_t size, const LoopBody & body)
+{
+    if (size > 0) {
+        body(0, size);
+    }
+}
+
+void SerialExecutor::run(const TaskGraph & graph, const TaskBody & body)
+{
+    vector<size_t> waiting(graph.dependencies);
+
+    // Stack of ready tasks, the first task on top
+    vector<size_t> ready;
+    for (size_t task = graph.size(); task-- > 0;) {
+        if (waiting[task] == 0) {
+            ready.push_back(task);
+        }
+    }
+
+    while (!ready.empty()) {
+        const size_t task = ready.back();
+        ready.pop_back();
+
+        body(task);
+
+        const auto & successors = graph.successors[task];
+        for (auto successor = successors.rbegin(); successor != successors.rend(); ++successor) {
+            if (--waiting[*successor] == 0) {
+                ready.push_back(*successor);
+            }
+        }
+    }
+}
+
+
+ThreadPool::ThreadPool(size_t threads) :
+  _stopping(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Calling thread is the remaining one
+    for (size_t i = 1; i < threads; ++i) {
+        _workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() noexcept
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _task_available.notify_all();
+
+    for (auto & worker : _workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(size_t size, const LoopBody & body)
+{
+    if (size == 0) {
+        return;
+    }
+
+    const size_t chunks = min(size, concurrency());
+
+    size_t pending = chunks;
+    exception_ptr error;
+
+    unique_lock<mutex> lock(_mutex);
+
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        const size_t begin = size * chunk / chunks;
+        const size_t end = size * (chunk + 1) / chunks;
+
+        _tasks.emplace_back([this, &body, &pending, &error, begin, end] {
+            exception_ptr chunk_error;
+            try {
+                body(begin, end);
+            } catch (...) {
+                chunk_error = std::current_exception();
+            }
+
+            lock_guard<mutex> lock(_mutex);
+            if (chunk_error && !error) {
+                error = chunk_error;
+            }
+            if (--pending == 0) {
+                _task_finished.notify_all();
+            }
+        });
+    }
+
+    _task_available.notify_all();
+
+    // Help the workers until the last chunk of this loop is done
+    while (pending > 0) {
+        if (!run_pending_task(lock)) {
+            _task_finished.wait(lock);
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::work() noexcept
+{
+    unique_lock<mutex> lock(_mutex);
+
+    while (true) {
+        if (run_pending_task(lock)) {
+            continue;
+        }
+        if (_stopping) {
+            return;
+        }
+        _task_available.wait(lock);
+    }
+}
+
+bool ThreadPool::run_pending_task(unique_lock<mutex> & lock) noexcept
+{
+    if (_tasks.empty()) {
+        return false;
+    }
+
+    auto task = std::move(_tasks.front());
+    _tasks.pop_front();
+
+    lock.unlock();
+    task();
+    lock.lock();
+
+    return true;
+}
+
+
+WorkStealingPool::WorkStealingPool(size_t threads) :
+  _pending(0),
+  _stopping(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The first queue belongs to the calling thread
+    for (size_t i = 0; i < threads; ++i) {
+        _queues.emplace_back(new Queue());
+    }
+    for (size_t i = 1; i < threads; ++i) {
+        _workers.emplace_back(&WorkStealingPool::work, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() noexcept
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _changed.notify_all();
+
+    for (auto & worker : _workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::parallel_for(size_t size, const LoopBody & body)
+{
+    if (size == 0) {
+        return;
+    }
+
+    // More chunks than threads, so that threads done early can steal the rest
+    const size_t chunks = min(size, 4 * concurrency());
+
+    atomic<size_t> pending(chunks);
+    exception_ptr error;
+    mutex error_mutex;
+
+    const size_t queue = current_queue();
+
+    // Queued last chunk first, so the calling thread runs the chunks in order
+    for (size_t chunk = chunks; chunk-- > 0;) {
+        const size_t begin = size * chunk / chunks;
+        const size_t end = size * (chunk + 1) / chunks;
+
+        push(queue, [this, &body, &pending, &error, &error_mutex, begin, end] {
+            try {
+                body(begin, end);
+            } catch (...) {
+                lock_guard<mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+
+            if (--pending == 0) {
+                notify();
+            }
+        });
+    }
+    notify();
+
+    wait_until(queue, [&pending] { return pending == 0; });
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkStealingPool::run(const TaskGraph & graph, const TaskBody & body)
+{
+    if (graph.size() == 0) {
+        return;
+    }
+
+    vector<atomic<size_t>> waiting(graph.size());
+    for (size_t task = 0; task < graph.size(); ++task) {
+        waiting[task] = graph.dependencies[task];
+    }
+
+    atomic<size_t> pending(graph.size());
+    exception_ptr error;
+    mutex error_mutex;
+
+    std::function<void(size_t)> execute = [&](size_t task) {
+        // The graph may be gone once the last task is done, keep the pool at hand
+        WorkStealingPool * const pool = this;
+
+        try {
+            body(task);
+        } catch (...) {
+            lock_guard<mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+
+        // Tasks that became ready go to the queue of this thread, while their operands are fresh
+        const size_t queue = pool->current_queue();
+        const auto & successors = graph.successors[task];
+
+        bool pushed = false;
+        for (auto successor = successors.rbegin(); successor != successors.rend(); ++successor) {
+            if (--waiting[*successor] == 0) {
+                const size_t next = *successor;
+                pool->push(queue, [&execute, next] { execute(next); });
+                pushed = true;
+            }
+        }
+
+        if (--pending == 0 || pushed) {
+            pool->notify();
+        }
+    };
+
+    const size_t queue = current_queue();
+    for (size_t task = graph.size(); task-- > 0;) {
+        if (graph.dependencies[task] == 0) {
+            push(queue, [&execute, task] { execute(task); });
+        }
+    }
+    notify();
+
+    wait_until(queue, [&pending] { return pending == 0; });
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkStealingPool::work(size_t index) noexcept
+{
+    current_pool = this;
+    current_pool_queue = index;
+
+    while (true) {
+        if (run_pending_task(index)) {
+            continue;
+        }
+
+        unique_lock<mutex> lock(_mutex);
+        if (_stopping) {
+            return;
+        }
+        _changed.wait(lock, [this] { return _pending > 0 || _stopping; });
+    }
+}
+
+size_t WorkStealingPool::current_queue() const noexcept
+{
+    return (current_pool == this) ? current_pool_queue : 0;
+}
+
+void WorkStealingPool::push(size_t queue, std::function<void()> task)
+{
+    {
+        lock_guard<mutex> lock(_queues[queue]->mutex);
+        _queues[queue]->tasks.push_back(std::move(task));
+    }
+    ++_pending;
+}
+
+bool WorkStealingPool::run_pending_task(size_t queue) noexcept
+{
+    std::function<void()> task;
+
+    // Newest task of the own queue, otherwise the oldest task of another queue
+    for (size_t i = 0; i < _queues.size() && !task; ++i) {
+        auto & victim = *_queues[(queue + i) % _queues.size()];
+
+        lock_guard<mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) {
+            continue;
+        }
+
+        if (i == 0) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+        } else {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    --_pending;
+    task();
+
+    return true;
+}
+
+void WorkStealingPool::wait_until(size_t queue, const std::function<bool()> & done) noexcept
+{
+    while (!done()) {
+        if (run_pending_task(queue)) {
+            continue;
+        }
+
+        unique_lock<mutex> lock(_mutex);
+        _changed.wait(lock, [&] { return done() || _pending > 0; });
+    }
+}
+
+void WorkStealingPool::notify() noexcept
+{
+    // Taking the lock orders the change before the check of a thread about to wait
+    { lock_guard<mutex> lock(_mutex); }
+    _changed.notify_all();
+}
+
+
+namespace
+{
+
+shared_ptr<Executor> global_executor = std::make_shared<SerialExecutor>();
+atomic<size_t> global_parallel_threshold(2);
+
+// Set while the current thread runs a parallel loop body
+thread_local bool inside_parallel_loop = false;
+
+} // namespace
+
+shared_ptr<Executor> executor() noexcept
+{
+    return std::atomic_load(&global_executor);
+}
+
+void set_executor(shared_ptr<Executor> executor) noexcept
+{
+    if (!executor) {
+        executor = std::make_shared<SerialExecutor>();
+    }
+
+    std::atomic_store(&global_executor, executor);
+}
+
+size_t parallel_threshold() noexcept
+{
+    return global_parallel_threshold;
+}
+
+void set_parallel_threshold(size_t threshold) noexcept
+{
+    global_parallel_threshold = threshold;
+}
+
+void parallel_for(size_t size, const LoopBody & body)
+{
+    const auto current_executor = executor();
+
+    if (inside_parallel_loop || size < parallel_threshold() || current_executor->concurrency() < 2) {
+        if (size > 0) {
+            body(0, size);
+        }
+        return;
+    }
+
+    current_executor->parallel_for(size, [&body](size_t begin, size_t end) {
+        inside_parallel_loop = true;
+        try {
+            body(begin, end);
+        } catch (...) {
+            inside_parallel_loop = false;
+            throw;
+        }
+        inside_parallel_loop = false;
+    });
+}
+
+void run(const TaskGraph & graph, const TaskBody & body)
+{
+    const auto current_executor = executor();
+
+    if (inside_parallel_loop || current_executor->concurrency() < 2) {
+        SerialExecutor().run(graph, body);
+        return;
+    }
+
+    current_executor->run(graph, body);
+}
+
+} // namespace she
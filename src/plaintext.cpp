@@ -1,5 +1,9 @@
 #include <cmath>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 #include "she.hpp"
 #include "she/exceptions.hpp"
 
@@ -11,35 +15,163 @@ using std::vector;
 namespace she
 {
 
-PlaintextArray & PlaintextArray::operator^=(const PlaintextArray & other) noexcept
+namespace
+{
+
+using word_t = PlaintextArray::word_t;
+
+size_t words_for(size_t size) noexcept
+{
+    return (size + 63) / 64;
+}
+
+// Mask of the bits of word number `word` that lie below `size`
+word_t valid_bits(size_t size, size_t word) noexcept
 {
-    const size_t n = min(_elements.size(), other._elements.size());
+    if (size >= 64 * (word + 1)) {
+        return ~word_t(0);
+    }
+    if (size <= 64 * word) {
+        return 0;
+    }
+    return (word_t(1) << (size % 64)) - 1;
+}
+
+// Word kernels: AVX2 processes four words at a time, SSE2 two, and the tail is processed word by word
 
-    // Do bit-wise XOR
+void xor_words(word_t * a, const word_t * b, size_t n) noexcept
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        const auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        const auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(a + i), _mm256_xor_si256(x, y));
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= n; i += 2) {
+        const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const auto y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(a + i), _mm_xor_si128(x, y));
+    }
+#endif
+    for (; i < n; ++i) {
+        a[i] ^= b[i];
+    }
+}
+
+void and_words(word_t * a, const word_t * b, size_t n) noexcept
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        const auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        const auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(a + i), _mm256_and_si256(x, y));
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= n; i += 2) {
+        const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const auto y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(a + i), _mm_and_si128(x, y));
+    }
+#endif
+    for (; i < n; ++i) {
+        a[i] &= b[i];
+    }
+}
+
+bool equal_words(const word_t * a, const word_t * b, size_t n) noexcept
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        const auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        const auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        const auto difference = _mm256_xor_si256(x, y);
+        if (!_mm256_testz_si256(difference, difference)) {
+            return false;
+        }
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= n; i += 2) {
+        const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const auto y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) {
+            return false;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool zero_words(const word_t * a, size_t n) noexcept
+{
     for (size_t i = 0; i < n; ++i) {
-        _elements[i] = _elements[i] ^ other._elements[i];
+        if (a[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+
+PlaintextArray::PlaintextArray(const vector<bool> & plaintext) noexcept :
+  _size(plaintext.size()),
+  _words(words_for(plaintext.size()), 0)
+{
+    for (size_t i = 0; i < plaintext.size(); ++i) {
+        _words[i / 64] |= word_t(plaintext[i]) << (i % 64);
     }
+}
 
+PlaintextArray::PlaintextArray(vector<word_t> words, size_t size) noexcept :
+  _size(size),
+  _words(std::move(words))
+{
+    _words.resize(words_for(size), 0);
+    if (!_words.empty()) {
+        _words.back() &= valid_bits(size, _words.size() - 1);
+    }
+}
+
+PlaintextArray & PlaintextArray::operator^=(const PlaintextArray & other) noexcept
+{
     // If sizes don't match pad with zeros from the right
-    for (size_t i = n; i < other._elements.size(); ++i) {
-        _elements.push_back(other._elements[i]);
+    if (other._size > _size) {
+        resize(other._size);
     }
 
+    // Bits past the size are zero, so whole words can be added
+    xor_words(_words.data(), other._words.data(), other._words.size());
+
     return *this;
 }
 
 PlaintextArray & PlaintextArray::operator&=(const PlaintextArray & other) noexcept
 {
-    const size_t n = min(_elements.size(), other._elements.size());
+    const size_t n = min(_size, other._size);
+    const size_t size = max(_size, other._size);
 
-    // Do bit-wise AND
-    for (size_t i = 0; i < n; ++i) {
-        _elements[i] = _elements[i] & other._elements[i];
-    }
+    const size_t this_size = _size;
+    resize(size);
+
+    // Do word-wise AND over words where both arrays are defined
+    const size_t full_words = n / 64;
+    and_words(_words.data(), other._words.data(), full_words);
 
     // If sizes don't match pad with ones from the right
-    for (size_t i = n; i < other._elements.size(); ++i) {
-        _elements.push_back(other._elements[i]);
+    for (size_t w = full_words; w < _words.size(); ++w) {
+        const word_t word = _words[w] | ~valid_bits(this_size, w);
+        const word_t other_word = (w < other._words.size() ? other._words[w] : 0) | ~valid_bits(other._size, w);
+        _words[w] = word & other_word & valid_bits(size, w);
     }
 
     return *this;
@@ -47,16 +179,113 @@ PlaintextArray & PlaintextArray::operator&=(const PlaintextArray & other) noexce
 
 PlaintextArray & PlaintextArray::extend(const PlaintextArray & other) noexcept
 {
-    for (const auto & element : other._elements) {
-        _elements.push_back(element);
+    const size_t offset = _size;
+    resize(_size + other._size);
+
+    const size_t first = offset / 64;
+    const unsigned int shift = offset % 64;
+
+    for (size_t w = 0; w < other._words.size(); ++w) {
+        _words[first + w] |= other._words[w] << shift;
+        if (shift != 0 && first + w + 1 < _words.size()) {
+            _words[first + w + 1] |= other._words[w] >> (64 - shift);
+        }
+    }
+
+    return *this;
+}
+
+PlaintextArray & PlaintextArray::resize(size_t size) noexcept
+{
+    _words.resize(words_for(size), 0);
+    if (size < _size && !_words.empty()) {
+        _words.back() &= valid_bits(size, _words.size() - 1);
     }
+    _size = size;
 
     return *this;
 }
 
+vector<bool> PlaintextArray::elements() const noexcept
+{
+    vector<bool> result(_size);
+    for (size_t i = 0; i < _size; ++i) {
+        result[i] = (*this)[i];
+    }
+
+    return result;
+}
+
 bool PlaintextArray::operator==(const PlaintextArray & other) const noexcept
 {
-    return _elements == other._elements;
+    return _size == other._size && equal_words(_words.data(), other._words.data(), _words.size());
+}
+
+const PlaintextArray
+PlaintextArray::equal(const std::vector<PlaintextArray> & arrays) const noexcept
+{
+    ASSERT(arrays.size() > 0, "Input array must not be empty");
+
+    PlaintextArray result {};
+    result.resize(arrays.size());
+
+    for (size_t i = 0; i < arrays.size(); ++i) {
+        const auto & array = arrays[i];
+        const size_t n = min(_words.size(), array._words.size());
+
+        // Arrays are equal iff their difference (xor) is all zeros, shorter one padded with zeros
+        const bool all = equal_words(_words.data(), array._words.data(), n)
+                         && zero_words(_words.data() + n, _words.size() - n)
+                         && zero_words(array._words.data() + n, array._words.size() - n);
+
+        result.set(i, all);
+    }
+
+    return result;
+}
+
+const PlaintextArray
+PlaintextArray::select(const std::vector<PlaintextArray> & arrays) const noexcept
+{
+    ASSERT(arrays.size() > 0, "Input array must not be empty");
+
+    const size_t n = min(_size, arrays.size());
+
+    // If sizes don't match pad with zeros from the right
+    size_t size = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size = max(size, arrays[i]._size);
+    }
+
+    PlaintextArray result {};
+    result.resize(size);
+
+    // Add up the arrays for which i-th element of this is one, skip zeros
+    for (size_t i = 0; i < n; ++i) {
+        if ((*this)[i]) {
+            xor_words(result._words.data(), arrays[i]._words.data(), arrays[i]._words.size());
+        }
+    }
+
+    return result;
+}
+
+const PlaintextArray
+PlaintextArray::demux() const noexcept
+{
+    ASSERT(_size > 0, "Index must not be empty");
+    ASSERT(_size < 8 * sizeof(size_t), "Index is too large");
+
+    size_t index = 0;
+    for (size_t i = 0; i < _size; ++i) {
+        index = (index << 1) | (*this)[i];
+    }
+
+    PlaintextArray result {};
+    result.resize(size_t(1) << _size);
+    result.set(index, 1);
+
+    return result;
 }
 
-} // namespace she
\ No newline at end of file
+} // namespace she
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "she/planner.hpp"
+#include "she/exceptions.hpp"
+
+using std::max;
+
+
+namespace she
+{
+
+namespace
+{
+
+// Bits needed to add up `count` values
+unsigned int sum_bits(uint64_t count) noexcept
+{
+    unsigned int bits = 0;
+    while ((uint64_t(1) << bits) < count) {
+        ++bits;
+    }
+    return bits;
+}
+
+// Smallest size of a prime factor that the elliptic curve method needs 2^security steps
+// to find, with running time exp(sqrt(2 ln p ln ln p))
+unsigned int ecm_bits(unsigned int security) noexcept
+{
+    unsigned int bits = 2;
+    while (std::sqrt(2 * bits * std::log(2.0) * std::log(bits * std::log(2.0))) < security * std::log(2.0)) {
+        ++bits;
+    }
+    return bits;
+}
+
+// Word operations of a product of two `words`-word numbers
+double product_cost(double words) noexcept
+{
+    return std::pow(words, std::log2(3.0));
+}
+
+} // namespace
+
+
+ParameterPlan plan_parameters(unsigned int security, const CircuitShape & shape, unsigned int seed,
+                              PRFMode prf_mode)
+{
+    ASSERT(security > 0, "Security parameter should be greater than 0");
+    ASSERT(shape.fan_in > 0, "Multiplications should have at least one operand");
+
+    const uint64_t limit = std::numeric_limits<unsigned int>::max();
+
+    const uint64_t rho = 2 * uint64_t(security);
+
+    // Fresh noise 2r + m with r in [1, 2^rho] is below 2^(rho + 2). Sums add a bit per doubling
+    // of terms, products add up the bits of the factors. Elements stay positive, so they
+    // decrypt correctly while the noise is below the private element
+    const unsigned int addition_bits = sum_bits(uint64_t(shape.additions) + 1);
+
+    uint64_t noise = rho + 2 + addition_bits;
+    for (unsigned int level = 0; level < shape.depth; ++level) {
+        noise = shape.fan_in * noise + addition_bits;
+        ASSERT(noise < limit, "Circuit is too deep for any parameter set");
+    }
+
+    // Private element has its top bit set
+    const uint64_t eta = max<uint64_t>({noise + 1, ecm_bits(security), rho + 1});
+
+    const uint64_t gamma = max<uint64_t>(eta * eta * sum_bits(security), eta + 1);
+    ASSERT(gamma <= limit, "Ciphertext size of " << gamma << " bits is too large");
+
+    ParameterPlan plan;
+    plan.parameter_set = ParameterSet(security, rho, eta, gamma, seed, prf_mode);
+    plan.noise_bits = noise;
+    plan.ciphertext_bytes = (gamma + 7) / 8;
+    plan.compressed_bytes = (eta + 7) / 8;
+
+    const double words = (gamma + 63) / 64;
+    plan.addition_cost = words;
+    plan.multiplication_cost = 3 * product_cost(words);
+
+    return plan;
+}
+
+} // namespace she
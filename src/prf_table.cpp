@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "she/prf_table.hpp"
+#include "she/exceptions.hpp"
+
+using std::ofstream;
+using std::string;
+using std::vector;
+
+
+namespace she
+{
+
+namespace
+{
+
+const char TABLE_MAGIC[8] = {'S', 'H', 'E', 'P', 'R', 'F', 'T', '1'};
+const uint32_t TABLE_BYTE_ORDER = 0x01020304;
+
+size_t stride_limbs(unsigned int size) noexcept
+{
+    return (size + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+}
+
+} // namespace
+
+
+void PRFTable::write( const string & path
+                    , unsigned int size
+                    , unsigned int seed
+                    , PRFMode mode
+                    , size_t count)
+{
+    Header header;
+    std::memcpy(header.magic, TABLE_MAGIC, sizeof(header.magic));
+    header.byte_order = TABLE_BYTE_ORDER;
+    header.limb_bytes = sizeof(mp_limb_t);
+    header.size = size;
+    header.seed = seed;
+    header.mode = static_cast<uint32_t>(mode);
+    header.reserved = 0;
+    header.count = count;
+    header.stride = stride_limbs(size);
+
+    ofstream file(path, std::ios::binary | std::ios::trunc);
+    ASSERT(file, "Cannot create PRF table " << path);
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    // Same sequences as produced by PseudoRandomStream
+    gmp_randclass generator(gmp_randinit_default);
+    generator.seed(seed);
+    const PseudoRandomFunction function(size, seed);
+
+    vector<mp_limb_t> limbs(header.stride);
+    for (size_t index = 0; index < count; ++index) {
+        const mpz_class value = (mode == PRFMode::counter) ? function(index)
+                                                           : mpz_class(generator.get_z_bits(size));
+
+        const size_t used = mpz_size(value.get_mpz_t());
+        std::fill(limbs.begin(), limbs.end(), 0);
+        std::copy(mpz_limbs_read(value.get_mpz_t()), mpz_limbs_read(value.get_mpz_t()) + used,
+                  limbs.begin());
+
+        file.write(reinterpret_cast<const char *>(limbs.data()), limbs.size() * sizeof(mp_limb_t));
+    }
+
+    file.close();
+    ASSERT(file, "Cannot write PRF table " << path);
+}
+
+PRFTable::PRFTable(const string & path) :
+  _mapping(MAP_FAILED),
+  _mapping_size(0),
+  _limbs(nullptr)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    ASSERT(fd >= 0, "Cannot open PRF table " << path);
+
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        _mapping_size = status.st_size;
+        _mapping = mmap(nullptr, _mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    ASSERT(_mapping != MAP_FAILED, "Cannot map PRF table " << path);
+
+    if (_mapping_size >= sizeof(Header)) {
+        std::memcpy(&_header, _mapping, sizeof(Header));
+    } else {
+        std::memset(&_header, 0, sizeof(Header));
+    }
+
+    // Count comes from the file, so it is compared by division where a product could wrap
+    const bool valid =
+        _mapping_size >= sizeof(Header)
+        && std::memcmp(_header.magic, TABLE_MAGIC, sizeof(TABLE_MAGIC)) == 0
+        && _header.byte_order == TABLE_BYTE_ORDER
+        && _header.limb_bytes == sizeof(mp_limb_t)
+        && _header.mode <= static_cast<uint32_t>(PRFMode::counter)
+        && _header.stride == stride_limbs(_header.size)
+        && _header.stride > 0
+        && (_mapping_size - sizeof(Header)) % (_header.stride * sizeof(mp_limb_t)) == 0
+        && _header.count == (_mapping_size - sizeof(Header)) / (_header.stride * sizeof(mp_limb_t));
+
+    if (!valid) {
+        munmap(_mapping, _mapping_size);
+        _mapping = MAP_FAILED;
+    }
+    ASSERT(valid, "Invalid PRF table " << path);
+
+    _limbs = reinterpret_cast<const mp_limb_t *>(static_cast<const char *>(_mapping) + sizeof(Header));
+}
+
+PRFTable::~PRFTable() noexcept
+{
+    if (_mapping != MAP_FAILED) {
+        munmap(_mapping, _mapping_size);
+    }
+}
+
+mpz_srcptr PRFTable::view(size_t index, mpz_ptr storage) const
+{
+    ASSERT(index < count(), "Index out of range");
+
+    // Leading zero limbs are normalized away
+    return mpz_roinit_n(storage, _limbs + index * _header.stride, _header.stride);
+}
+
+mpz_class PRFTable::operator[](size_t index) const
+{
+    mpz_t storage;
+    return mpz_class(view(index, storage));
+}
+
+} // namespace she
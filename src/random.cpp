@@ -1,13 +1,18 @@
 #include <random>
 
 #include "she/random.hpp"
+#include "she/prf_table.hpp"
 #include "she/defs.hpp"
+#include "she/exceptions.hpp"
 
 using std::out_of_range;
 using std::random_device;
+using std::lock_guard;
 using std::make_pair;
-using std::map;
+using std::make_shared;
+using std::mutex;
 using std::pair;
+using std::shared_ptr;
 using std::vector;
 
 
@@ -41,31 +46,281 @@ CSPRNG::get_range(const mpz_class & upper_bound) const noexcept
 }
 
 
-PseudoRandomStream::PseudoRandomStream(unsigned int size, unsigned int seed) :
+namespace
+{
+
+inline uint32_t rotate_left(uint32_t value, unsigned int bits) noexcept
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+inline void quarter_round(uint32_t & a, uint32_t & b, uint32_t & c, uint32_t & d) noexcept
+{
+    a += b; d ^= a; d = rotate_left(d, 16);
+    c += d; b ^= c; b = rotate_left(b, 12);
+    a += b; d ^= a; d = rotate_left(d, 8);
+    c += d; b ^= c; b = rotate_left(b, 7);
+}
+
+// ChaCha20 block function with 64-bit block counter and 64-bit nonce
+void chacha20_block( const std::array<uint32_t, 8> & key
+                   , uint64_t counter
+                   , uint64_t nonce
+                   , uint32_t * output) noexcept
+{
+    const uint32_t input[16] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+        key[0], key[1], key[2], key[3],
+        key[4], key[5], key[6], key[7],
+        static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32),
+        static_cast<uint32_t>(nonce), static_cast<uint32_t>(nonce >> 32),
+    };
+
+    uint32_t x[16];
+    for (size_t i = 0; i < 16; ++i) {
+        x[i] = input[i];
+    }
+
+    for (size_t round = 0; round < 10; ++round) {
+        quarter_round(x[0], x[4], x[8],  x[12]);
+        quarter_round(x[1], x[5], x[9],  x[13]);
+        quarter_round(x[2], x[6], x[10], x[14]);
+        quarter_round(x[3], x[7], x[11], x[15]);
+        quarter_round(x[0], x[5], x[10], x[15]);
+        quarter_round(x[1], x[6], x[11], x[12]);
+        quarter_round(x[2], x[7], x[8],  x[13]);
+        quarter_round(x[3], x[4], x[9],  x[14]);
+    }
+
+    for (size_t i = 0; i < 16; ++i) {
+        output[i] = x[i] + input[i];
+    }
+}
+
+} // namespace
+
+
+PseudoRandomFunction::PseudoRandomFunction(unsigned int size, unsigned int seed) noexcept :
+  _size(size),
+  // Key is the seed and the output size, padded with "libshe prf"
+  _key{{seed, size, 0x7362696c, 0x70206568, 0x00006672, 0, 0, 0}}
+{}
+
+mpz_class PseudoRandomFunction::operator()(size_t index) const noexcept
+{
+    // Keystream for the index as nonce, 512 bits per block
+    const size_t words = (_size + 31) / 32;
+    vector<uint32_t> keystream(16 * ((words + 15) / 16));
+
+    for (size_t block = 0; 16 * block < words; ++block) {
+        chacha20_block(_key, block, index, &keystream[16 * block]);
+    }
+
+    // Keep exactly `size` low bits
+    if (_size % 32 != 0) {
+        keystream[words - 1] &= (uint32_t(1) << (_size % 32)) - 1;
+    }
+
+    mpz_class result;
+    mpz_import(result.get_mpz_t(), words, -1, sizeof(uint32_t), 0, 0, keystream.data());
+    return result;
+}
+
+
+PRFCache::PRFCache(size_t capacity_bytes) noexcept :
+  _capacity(capacity_bytes),
+  _statistics{0, 0, 0, 0, 0}
+{}
+
+size_t PRFCache::footprint(const mpz_class & value) noexcept
+{
+    return sizeof(mpz_class) + mpz_size(value.get_mpz_t()) * sizeof(mp_limb_t);
+}
+
+PRFCache::value_t PRFCache::find(const key_t & key) noexcept
+{
+    lock_guard<mutex> lock(_mutex);
+
+    const auto it = _index.find(key);
+    if (it == _index.end()) {
+        ++_statistics.misses;
+        return nullptr;
+    }
+
+    ++_statistics.hits;
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return it->second->second;
+}
+
+void PRFCache::insert(const key_t & key, const value_t & value) noexcept
+{
+    const size_t bytes = footprint(*value);
+
+    lock_guard<mutex> lock(_mutex);
+
+    const auto it = _index.find(key);
+    if (it != _index.end()) {
+        _statistics.bytes -= footprint(*it->second->second);
+        _entries.erase(it->second);
+        _index.erase(it);
+        --_statistics.entries;
+    }
+
+    if (bytes > _capacity) {
+        return;
+    }
+
+    evict(_capacity - bytes);
+
+    _entries.emplace_front(key, value);
+    _index[key] = _entries.begin();
+    _statistics.bytes += bytes;
+    ++_statistics.entries;
+}
+
+void PRFCache::evict(size_t capacity_bytes) noexcept
+{
+    while (_statistics.bytes > capacity_bytes) {
+        const auto & last = _entries.back();
+        _statistics.bytes -= footprint(*last.second);
+        _index.erase(last.first);
+        _entries.pop_back();
+        --_statistics.entries;
+        ++_statistics.evictions;
+    }
+}
+
+size_t PRFCache::capacity() const noexcept
+{
+    lock_guard<mutex> lock(_mutex);
+    return _capacity;
+}
+
+void PRFCache::set_capacity(size_t capacity_bytes) noexcept
+{
+    lock_guard<mutex> lock(_mutex);
+    _capacity = capacity_bytes;
+    evict(_capacity);
+}
+
+PRFCache::Statistics PRFCache::statistics() const noexcept
+{
+    lock_guard<mutex> lock(_mutex);
+    return _statistics;
+}
+
+void PRFCache::reset_statistics() noexcept
+{
+    lock_guard<mutex> lock(_mutex);
+    _statistics.hits = 0;
+    _statistics.misses = 0;
+    _statistics.evictions = 0;
+}
+
+void PRFCache::clear() noexcept
+{
+    lock_guard<mutex> lock(_mutex);
+    _entries.clear();
+    _index.clear();
+    _statistics.entries = 0;
+    _statistics.bytes = 0;
+}
+
+
+namespace
+{
+
+using table_key_t = std::tuple<PRFMode, unsigned int, unsigned int>;
+
+mutex attached_tables_mutex;
+std::map<table_key_t, shared_ptr<const PRFTable>> attached_tables;
+
+} // namespace
+
+
+PseudoRandomStream::PseudoRandomStream(unsigned int size, unsigned int seed, PRFMode mode) :
   _size(size),
   _seed(seed),
+  _mode(mode),
   _generator(gmp_randinit_default),
+  _function(size, seed),
+  _generator_position(0),
   _current_value(0)
 {
     _generator.seed(seed);
+
+    lock_guard<mutex> lock(attached_tables_mutex);
+    const auto it = attached_tables.find(table_key_t{mode, size, seed});
+    if (it != attached_tables.end()) {
+        _table = it->second;
+    }
 }
 
-map<PseudoRandomStream::keys_t, PseudoRandomStream::values_t> PseudoRandomStream::cached_values = {};
+void PseudoRandomStream::attach_table(shared_ptr<const PRFTable> table) noexcept
+{
+    lock_guard<mutex> lock(attached_tables_mutex);
+    attached_tables[table_key_t{table->mode(), table->size(), table->seed()}] = table;
+}
 
-const mpz_class & PseudoRandomStream::next() const noexcept
+void PseudoRandomStream::detach_tables() noexcept
 {
-    keys_t context{_size, _seed};
-    auto it = PseudoRandomStream::cached_values.find(context);
+    lock_guard<mutex> lock(attached_tables_mutex);
+    attached_tables.clear();
+}
+
+PRFCache & PseudoRandomStream::cache() noexcept
+{
+    static PRFCache shared_cache(PRF_CACHE_CAPACITY);
+    return shared_cache;
+}
 
-    if (it != cached_values.end()) {
-        if (it->second.size() <= _current_value) {
-            it->second.push_back(_generator.get_z_bits(_size));
+PRFCache::value_t PseudoRandomStream::value(size_t index) const noexcept
+{
+    // Table values are already shared between processes, they are not cached
+    if (_table && index < _table->count()) {
+        return make_shared<const mpz_class>((*_table)[index]);
+    }
+
+    const auto cached = cache().find(PRFCache::key_t{_mode, _size, _seed, index});
+    if (cached) {
+        return cached;
+    }
+
+    if (_mode == PRFMode::counter) {
+        const auto computed = make_shared<const mpz_class>(_function(index));
+        cache().insert(PRFCache::key_t{_mode, _size, _seed, index}, computed);
+        return computed;
+    }
+
+    // Values of the sequential generator can only be reproduced by replaying it
+    if (_generator_position > index) {
+        _generator.seed(_seed);
+        _generator_position = 0;
+    }
+
+    PRFCache::value_t computed;
+    while (_generator_position <= index) {
+        computed = make_shared<const mpz_class>(_generator.get_z_bits(_size));
+        if (!_table || _generator_position >= _table->count()) {
+            cache().insert(PRFCache::key_t{_mode, _size, _seed, _generator_position}, computed);
         }
-    } else {
-        cached_values[context] = vector<mpz_class>{_generator.get_z_bits(_size)};
+        ++_generator_position;
     }
 
-    return cached_values[context][_current_value++];
+    return computed;
+}
+
+const mpz_class & PseudoRandomStream::next() const noexcept
+{
+    _value = value(_current_value++);
+    return *_value;
+}
+
+mpz_class PseudoRandomStream::at(size_t index) const
+{
+    ASSERT(random_access(), "Random access requires counter mode");
+
+    return *value(index);
 }
 
 const void PseudoRandomStream::reset() const noexcept
@@ -73,4 +328,4 @@ const void PseudoRandomStream::reset() const noexcept
     _current_value = 0;
 }
 
-}
+} // namespace she
@@ -0,0 +1,81 @@
+#include "she/reduction.hpp"
+#include "she/exceptions.hpp"
+
+
+namespace she
+{
+
+ReductionContext::ReductionContext(const mpz_class & modulus) :
+  _modulus(modulus),
+  _modulus_bits(mpz_sizeinbase(modulus.get_mpz_t(), 2))
+{
+    ASSERT(modulus > 0, "Modulus must be positive");
+
+    mpz_class power = 1;
+    power <<= 2 * _modulus_bits;
+    _reciprocal = power / _modulus;
+}
+
+void ReductionContext::reduce(mpz_class & value) const noexcept
+{
+    // Keep truncated division semantics for negative values
+    if (sgn(value) < 0) {
+        value %= _modulus;
+        return;
+    }
+
+    if (value < _modulus) {
+        return;
+    }
+
+    const size_t value_bits = mpz_sizeinbase(value.get_mpz_t(), 2);
+
+    // Sums of reduced values: value < 2^(k+1) <= 4 * modulus, at most three subtractions
+    if (value_bits <= _modulus_bits + 1) {
+        do {
+            value -= _modulus;
+        } while (value >= _modulus);
+        return;
+    }
+
+    // Products of reduced values: Barrett reduction, estimated quotient is off by at most 2
+    if (value_bits <= 2 * _modulus_bits) {
+        mpz_class quotient = value >> (_modulus_bits - 1);
+        quotient *= _reciprocal;
+        quotient >>= _modulus_bits + 1;
+        value -= quotient * _modulus;
+        while (value >= _modulus) {
+            value -= _modulus;
+        }
+        return;
+    }
+
+    // Anything larger falls back to long division
+    value %= _modulus;
+}
+
+void ReductionContext::reduce(mpz_class & value, unsigned int headroom_bits) const noexcept
+{
+    // Size of the value in bits serves as the bound on its magnitude
+    if (headroom_bits == 0 || mpz_sizeinbase(value.get_mpz_t(), 2) > _modulus_bits + headroom_bits) {
+        reduce(value);
+    }
+}
+
+void ReductionContext::multiply(mpz_class & value, const mpz_class & other) const noexcept
+{
+    // Bring lazily reduced operands below the modulus so that the product stays in Barrett range
+    reduce(value);
+
+    if (mpz_sizeinbase(other.get_mpz_t(), 2) > _modulus_bits) {
+        mpz_class reduced_other = other;
+        reduce(reduced_other);
+        value *= reduced_other;
+    } else {
+        value *= other;
+    }
+
+    reduce(value);
+}
+
+} // namespace she
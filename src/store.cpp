@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "she/store.hpp"
+#include "she/exceptions.hpp"
+
+using std::max;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+namespace she
+{
+
+namespace
+{
+
+const char STORE_MAGIC[8] = {'S', 'H', 'E', 'A', 'R', 'R', 'S', '1'};
+const uint32_t STORE_BYTE_ORDER = 0x01020304;
+
+// Write a nonnegative value below 2^(stride * GMP_NUMB_BITS) as exactly `stride` limbs
+void write_limbs(std::ofstream & file, const mpz_class & value, vector<mp_limb_t> & buffer)
+{
+    const size_t used = mpz_size(value.get_mpz_t());
+    std::fill(buffer.begin(), buffer.end(), 0);
+    std::copy(mpz_limbs_read(value.get_mpz_t()), mpz_limbs_read(value.get_mpz_t()) + used,
+              buffer.begin());
+
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(mp_limb_t));
+}
+
+} // namespace
+
+
+EncryptedArrayStore::Writer::Writer( const string & path
+                                   , shared_ptr<const EvaluationContext> context
+                                   , unsigned int max_degree) :
+  _file(path, std::ios::binary | std::ios::trunc),
+  _path(path),
+  _context(std::move(context)),
+  _elements(0),
+  _closed(false)
+{
+    ASSERT(_context, "EncryptedArray must be initialized");
+    ASSERT(_file, "Cannot create encrypted array store " << path);
+
+    std::memcpy(_header.magic, STORE_MAGIC, sizeof(_header.magic));
+    _header.byte_order = STORE_BYTE_ORDER;
+    _header.limb_bytes = sizeof(mp_limb_t);
+    _header.stride = mpz_size(_context->public_element().get_mpz_t());
+    _header.count = 0;
+    _header.table_offset = 0;
+    _header.max_degree = max_degree;
+    _header.noise_limit = 0;
+
+    // Header is rewritten on close, once the table position is known
+    _file.write(reinterpret_cast<const char *>(&_header), sizeof(_header));
+
+    vector<mp_limb_t> buffer(_header.stride);
+    write_limbs(_file, _context->public_element(), buffer);
+}
+
+EncryptedArrayStore::Writer::~Writer() noexcept
+{
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void EncryptedArrayStore::Writer::append(const EncryptedArray & array)
+{
+    ASSERT(!_closed, "Encrypted array store is closed");
+    ASSERT(array.public_element() == _context->public_element(),
+           "Arrays must have the public element of the store");
+
+    const auto & context = _context->reduction();
+
+    vector<mp_limb_t> buffer(_header.stride);
+    mpz_class reduced;
+    for (const auto & element : array.elements()) {
+        reduced = element;
+        context.reduce(reduced);
+        write_limbs(_file, reduced, buffer);
+    }
+    ASSERT(_file, "Cannot write encrypted array store " << _path);
+
+    const auto noise_bits = static_cast<uint32_t>(std::ceil(array.noise_bits()));
+    _records.push_back(Record{_elements, array.size(), array.degree(), noise_bits});
+    _header.noise_limit = max(_header.noise_limit, uint32_t(array.noise_limit()));
+    _elements += array.size();
+}
+
+void EncryptedArrayStore::Writer::close()
+{
+    if (_closed) {
+        return;
+    }
+    _closed = true;
+
+    _header.count = _records.size();
+    _header.table_offset = sizeof(Header) + (_elements + 1) * _header.stride * sizeof(mp_limb_t);
+
+    _file.write(reinterpret_cast<const char *>(_records.data()), _records.size() * sizeof(Record));
+    _file.seekp(0);
+    _file.write(reinterpret_cast<const char *>(&_header), sizeof(_header));
+    _file.close();
+
+    ASSERT(_file, "Cannot write encrypted array store " << _path);
+}
+
+
+void EncryptedArrayStore::write(const string & path, const vector<EncryptedArray> & arrays)
+{
+    ASSERT(arrays.size() > 0, "Input array must not be empty");
+
+    unsigned int max_degree = 0;
+    for (const auto & array : arrays) {
+        max_degree = max(max_degree, array.max_degree());
+    }
+
+    Writer writer(path, arrays.front().context(), max_degree);
+    for (const auto & array : arrays) {
+        writer.append(array);
+    }
+    writer.close();
+}
+
+
+EncryptedArrayStore::EncryptedArrayStore(const string & path) :
+  _mapping(MAP_FAILED),
+  _mapping_size(0),
+  _elements(nullptr),
+  _records(nullptr)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    ASSERT(fd >= 0, "Cannot open encrypted array store " << path);
+
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        _mapping_size = status.st_size;
+        _mapping = mmap(nullptr, _mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    ASSERT(_mapping != MAP_FAILED, "Cannot map encrypted array store " << path);
+
+    if (_mapping_size >= sizeof(Header)) {
+        std::memcpy(&_header, _mapping, sizeof(Header));
+    } else {
+        std::memset(&_header, 0, sizeof(Header));
+    }
+
+    const auto * bytes = static_cast<const char *>(_mapping);
+
+    // Sizes come from the file. They are bounded by the mapping size before they are multiplied,
+    // and the count is compared by division, so nothing can wrap
+    const bool valid_stride = _header.stride > 0 && _header.stride <= _mapping_size / sizeof(mp_limb_t);
+    const size_t element_bytes = valid_stride ? _header.stride * sizeof(mp_limb_t) : 0;
+
+    bool valid =
+        _mapping_size >= sizeof(Header)
+        && std::memcmp(_header.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) == 0
+        && _header.byte_order == STORE_BYTE_ORDER
+        && _header.limb_bytes == sizeof(mp_limb_t)
+        && valid_stride
+        && _header.table_offset >= sizeof(Header)
+        && _header.table_offset <= _mapping_size
+        && _header.table_offset - sizeof(Header) >= element_bytes
+        && (_header.table_offset - sizeof(Header)) % element_bytes == 0
+        && (_mapping_size - _header.table_offset) % sizeof(Record) == 0
+        && _header.count == (_mapping_size - _header.table_offset) / sizeof(Record);
+
+    if (valid) {
+        _elements = reinterpret_cast<const mp_limb_t *>(bytes + sizeof(Header));
+        _records = reinterpret_cast<const Record *>(bytes + _header.table_offset);
+
+        // Every array must lie within the stored elements
+        const uint64_t elements = (_header.table_offset - sizeof(Header)) / element_bytes - 1;
+        for (size_t i = 0; valid && i < _header.count; ++i) {
+            valid = _records[i].offset <= elements && _records[i].size <= elements - _records[i].offset;
+        }
+    }
+
+    if (!valid) {
+        munmap(_mapping, _mapping_size);
+        _mapping = MAP_FAILED;
+    }
+    ASSERT(valid, "Invalid encrypted array store " << path);
+
+    mpz_t storage;
+    const mpz_class public_element(mpz_roinit_n(storage, _elements, _header.stride));
+    _context = EvaluationContext::get(public_element);
+
+    // Stored elements follow the public element
+    _elements += _header.stride;
+}
+
+EncryptedArrayStore::~EncryptedArrayStore() noexcept
+{
+    if (_mapping != MAP_FAILED) {
+        munmap(_mapping, _mapping_size);
+    }
+}
+
+EncryptedArrayStore::View EncryptedArrayStore::operator[](size_t index) const
+{
+    ASSERT(index < size(), "Index out of range");
+
+    return View(*this, _records[index]);
+}
+
+mpz_srcptr EncryptedArrayStore::View::element(size_t index, mpz_ptr storage) const
+{
+    ASSERT(index < size(), "Index out of range");
+
+    const auto stride = _store->_header.stride;
+    return mpz_roinit_n(storage, _store->_elements + (_record->offset + index) * stride, stride);
+}
+
+EncryptedArray EncryptedArrayStore::View::load() const noexcept
+{
+    EncryptedArray result(_store->context(), _store->max_degree(), degree());
+
+    auto & elements = result.elements();
+    elements.resize(size());
+    for (size_t i = 0; i < size(); ++i) {
+        mpz_t storage;
+        elements[i] = mpz_class(element(i, storage));
+    }
+    result.set_noise(noise_bits(), _store->noise_limit());
+
+    return result;
+}
+
+} // namespace she
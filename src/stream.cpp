@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "she/stream.hpp"
+#include "she/exceptions.hpp"
+
+using std::istream;
+using std::ostream;
+using std::shared_ptr;
+using std::vector;
+
+
+namespace she
+{
+
+namespace
+{
+
+const uint32_t ENCRYPTED_ARRAY_MAGIC = 0x41454853;       // "SHEA"
+const uint32_t COMPRESSED_CIPHERTEXT_MAGIC = 0x43454853; // "SHEC"
+const uint32_t STREAM_FORMAT_VERSION = 2;
+
+// Version 1 predates noise bounds in the encrypted array header
+const uint32_t STREAM_FORMAT_VERSION_NO_NOISE = 1;
+
+// Integers are read in chunks of this size, so a corrupt length fails at the end of the stream
+// instead of allocating all of it upfront
+const size_t INTEGER_CHUNK_BYTES = 1 << 16;
+
+// Bytes of an integer below 2^bits
+uint64_t integer_bytes(uint64_t bits) noexcept
+{
+    return (bits + 7) / 8;
+}
+
+void write_uint(ostream & output, uint64_t value, size_t bytes)
+{
+    char buffer[8];
+    for (size_t i = 0; i < bytes; ++i) {
+        buffer[i] = static_cast<char>(value >> (8 * i));
+    }
+    output.write(buffer, bytes);
+    ASSERT(output, "Stream write failed");
+}
+
+uint64_t read_uint(istream & input, size_t bytes)
+{
+    unsigned char buffer[8];
+    input.read(reinterpret_cast<char *>(buffer), bytes);
+    ASSERT(input, "Unexpected end of stream");
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value |= uint64_t(buffer[i]) << (8 * i);
+    }
+    return value;
+}
+
+void write_double(ostream & output, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    write_uint(output, bits, 8);
+}
+
+double read_double(istream & input)
+{
+    const uint64_t bits = read_uint(input, 8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Sign byte, byte length and magnitude, as in the binary archive encoding
+void write_integer(ostream & output, const mpz_class & value)
+{
+    const auto bytes = detail::export_magnitude(value);
+
+    write_uint(output, mpz_sgn(value.get_mpz_t()) < 0 ? 1 : 0, 1);
+    write_uint(output, bytes.size(), 8);
+    output.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    ASSERT(output, "Stream write failed");
+}
+
+// Integers longer than `max_bytes` are rejected
+void read_integer(istream & input, mpz_class & value, uint64_t max_bytes)
+{
+    const bool negative = read_uint(input, 1) != 0;
+    const uint64_t size = read_uint(input, 8);
+    ASSERT(size <= max_bytes, "Integer of " << size << " bytes exceeds the limit of " << max_bytes);
+
+    vector<unsigned char> bytes;
+    while (bytes.size() < size) {
+        const size_t offset = bytes.size();
+        bytes.resize(offset + std::min<uint64_t>(size - offset, INTEGER_CHUNK_BYTES));
+        input.read(reinterpret_cast<char *>(bytes.data() + offset), bytes.size() - offset);
+        ASSERT(input, "Unexpected end of stream");
+    }
+
+    detail::import_magnitude(value, bytes.data(), bytes.size(), negative);
+}
+
+// Public element of a stream that does not state its size
+void read_public_element(istream & input, mpz_class & value)
+{
+    read_integer(input, value, integer_bytes(std::numeric_limits<unsigned int>::max()));
+    ASSERT(value > 0, "Invalid public element");
+}
+
+void write_preamble(ostream & output, uint32_t magic)
+{
+    write_uint(output, magic, 4);
+    write_uint(output, STREAM_FORMAT_VERSION, 4);
+}
+
+uint32_t read_preamble(istream & input, uint32_t magic)
+{
+    ASSERT(read_uint(input, 4) == magic, "Unexpected stream contents");
+
+    const auto version = read_uint(input, 4);
+    ASSERT(version >= STREAM_FORMAT_VERSION_NO_NOISE && version <= STREAM_FORMAT_VERSION,
+           "Unsupported stream format version");
+    return version;
+}
+
+} // namespace
+
+
+EncryptedArrayWriter::EncryptedArrayWriter( ostream & output
+                                          , shared_ptr<const EvaluationContext> context
+                                          , size_t size
+                                          , unsigned int max_degree
+                                          , unsigned int degree
+                                          , double noise_bits
+                                          , unsigned int noise_limit) :
+  _output(output),
+  _context(std::move(context)),
+  _remaining(size)
+{
+    ASSERT(_context, "EncryptedArray must be initialized");
+
+    write_preamble(_output, ENCRYPTED_ARRAY_MAGIC);
+    write_uint(_output, size, 8);
+    write_uint(_output, max_degree, 4);
+    write_uint(_output, degree, 4);
+    write_double(_output, noise_bits);
+    write_uint(_output, noise_limit, 4);
+    write_integer(_output, _context->public_element());
+}
+
+EncryptedArrayWriter::EncryptedArrayWriter(ostream & output, const EncryptedArray & array) :
+  EncryptedArrayWriter( output, array.context(), array.size(), array.max_degree(), array.degree()
+                      , array.noise_bits(), array.noise_limit())
+{
+    for (const auto & element : array.elements()) {
+        write(element);
+    }
+}
+
+void EncryptedArrayWriter::write(const mpz_class & element)
+{
+    ASSERT(_remaining > 0, "All elements have been written");
+
+    const auto & context = _context->reduction();
+    if (element < 0 || mpz_sizeinbase(element.get_mpz_t(), 2) > context.modulus_bits()) {
+        mpz_class reduced = element;
+        context.reduce(reduced);
+        write_integer(_output, reduced);
+    } else {
+        write_integer(_output, element);
+    }
+
+    --_remaining;
+}
+
+
+EncryptedArrayReader::EncryptedArrayReader(istream & input) :
+  _input(input)
+{
+    const auto version = read_preamble(_input, ENCRYPTED_ARRAY_MAGIC);
+    _size = read_uint(_input, 8);
+    _max_degree = read_uint(_input, 4);
+    _degree = read_uint(_input, 4);
+
+    // Noise of arrays from older streams is unknown and left unchecked
+    _noise_bits = 0;
+    _noise_limit = 0;
+    if (version > STREAM_FORMAT_VERSION_NO_NOISE) {
+        _noise_bits = read_double(_input);
+        _noise_limit = read_uint(_input, 4);
+    }
+
+    mpz_class public_element;
+    read_public_element(_input, public_element);
+    _context = EvaluationContext::get(public_element);
+
+    _remaining = _size;
+}
+
+bool EncryptedArrayReader::next(mpz_class & element)
+{
+    if (_remaining == 0) {
+        return false;
+    }
+
+    // Elements are written reduced
+    read_integer(_input, element, integer_bytes(_context->reduction().modulus_bits()));
+    --_remaining;
+    return true;
+}
+
+EncryptedArray EncryptedArrayReader::read()
+{
+    EncryptedArray result(_context, _max_degree, _degree);
+    result.set_noise(_noise_bits, _noise_limit);
+
+    // Elements are added as they arrive, the size in the header is not trusted
+    mpz_class element;
+    while (next(element)) {
+        result.elements().push_back(element);
+    }
+
+    return result;
+}
+
+
+CompressedCiphertextWriter::CompressedCiphertextWriter( ostream & output
+                                                      , const ParameterSet & parameter_set
+                                                      , const mpz_class & public_element_delta
+                                                      , size_t size) :
+  _output(output),
+  _remaining(size)
+{
+    write_preamble(_output, COMPRESSED_CIPHERTEXT_MAGIC);
+    write_uint(_output, parameter_set.security, 4);
+    write_uint(_output, parameter_set.noise_size_bits, 4);
+    write_uint(_output, parameter_set.private_key_size_bits, 4);
+    write_uint(_output, parameter_set.ciphertext_size_bits, 4);
+    write_uint(_output, parameter_set.prf_seed, 4);
+    write_uint(_output, static_cast<uint32_t>(parameter_set.prf_mode), 4);
+    write_uint(_output, size, 8);
+    write_integer(_output, public_element_delta);
+}
+
+CompressedCiphertextWriter::CompressedCiphertextWriter( ostream & output
+                                                      , const CompressedCiphertext & ciphertext) :
+  CompressedCiphertextWriter( output
+                            , ciphertext.parameter_set()
+                            , ciphertext.public_element_delta()
+                            , ciphertext.size())
+{
+    for (const auto & element_delta : ciphertext.elements_deltas()) {
+        write(element_delta);
+    }
+}
+
+void CompressedCiphertextWriter::write(const mpz_class & element_delta)
+{
+    ASSERT(_remaining > 0, "All elements have been written");
+
+    write_integer(_output, element_delta);
+    --_remaining;
+}
+
+
+CompressedCiphertextReader::CompressedCiphertextReader(istream & input) :
+  _input(input)
+{
+    read_preamble(_input, COMPRESSED_CIPHERTEXT_MAGIC);
+    const auto security = read_uint(_input, 4);
+    const auto noise_size_bits = read_uint(_input, 4);
+    const auto private_key_size_bits = read_uint(_input, 4);
+    const auto ciphertext_size_bits = read_uint(_input, 4);
+    const auto prf_seed = read_uint(_input, 4);
+
+    const auto mode = read_uint(_input, 4);
+    ASSERT(mode <= static_cast<uint32_t>(PRFMode::counter), "Unknown PRF mode");
+
+    // Same checks as for parameter sets built in code
+    ASSERT(security > 0, "Security parameter should be greater than 0");
+    _parameter_set = ParameterSet( security, noise_size_bits, private_key_size_bits, ciphertext_size_bits
+                                 , prf_seed, static_cast<PRFMode>(mode));
+
+    _size = read_uint(_input, 8);
+    _remaining = _size;
+
+    // Deltas are differences of numbers below 2^gamma
+    _max_integer_bytes = integer_bytes(_parameter_set.ciphertext_size_bits);
+
+    mpz_class public_element_delta;
+    read_integer(_input, public_element_delta, _max_integer_bytes);
+
+    // Elements are restored in order, so both PRF modes are read sequentially
+    _prf_stream.reset(
+        new PseudoRandomStream{ _parameter_set.ciphertext_size_bits
+                              , _parameter_set.prf_seed
+                              , _parameter_set.prf_mode });
+
+    const mpz_class public_element = _prf_stream->next() - public_element_delta;
+    ASSERT(public_element > 0, "Invalid public element");
+    _context = EvaluationContext::get(public_element);
+}
+
+bool CompressedCiphertextReader::next(mpz_class & element)
+{
+    if (_remaining == 0) {
+        return false;
+    }
+
+    read_integer(_input, element, _max_integer_bytes);
+    element = _prf_stream->next() - element;
+    --_remaining;
+    return true;
+}
+
+EncryptedArray CompressedCiphertextReader::expand()
+{
+    EncryptedArray result(_context, _parameter_set.degree());
+
+    // Elements are added as they arrive, the size in the header is not trusted
+    mpz_class element;
+    while (next(element)) {
+        result.elements().push_back(element);
+    }
+
+    result.set_noise(_parameter_set.fresh_noise_bits(), _parameter_set.noise_limit_bits());
+
+    return result;
+}
+
+} // namespace she
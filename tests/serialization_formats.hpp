@@ -4,11 +4,15 @@
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
 
 using boost::archive::xml_oarchive;
 using boost::archive::xml_iarchive;
 using boost::archive::text_oarchive;
 using boost::archive::text_iarchive;
+using boost::archive::binary_oarchive;
+using boost::archive::binary_iarchive;
 
 
 template <class InputArchive, class OutputArchive>
@@ -18,4 +22,5 @@ struct Format {
 };
 
 using Formats = boost::mpl::list< Format<xml_iarchive, xml_oarchive>,
-                                  Format<text_iarchive, text_oarchive> >;
+                                  Format<text_iarchive, text_oarchive>,
+                                  Format<binary_iarchive, binary_oarchive> >;
@@ -0,0 +1,160 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE BristolModule
+#include <cstddef>
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "she.hpp"
+#include "she/bristol.hpp"
+#include "she/exceptions.hpp"
+#include "she/parallel.hpp"
+
+using std::make_shared;
+using std::istringstream;
+using std::string;
+using std::vector;
+
+using she::precondition_not_satisfied;
+using she::PrivateKey;
+using she::ParameterSet;
+using she::PlaintextArray;
+using she::EncryptedArray;
+using she::BristolCircuit;
+using she::WorkStealingPool;
+
+
+// Two-bit adder with carry, and the negated lowest bit of the first summand next to a constant
+const string ADDER_CIRCUIT =
+    "10 15\n"
+    "2 2 2\n"
+    "2 3 2\n"
+    "\n"
+    "2 1 0 2 4 XOR\n"
+    "2 1 0 2 5 AND\n"
+    "2 1 1 3 6 XOR\n"
+    "4 2 1 5 3 6 7 8 MAND\n"
+    "1 1 0 9 INV\n"
+    "1 1 4 10 EQW\n"
+    "2 1 6 5 11 XOR\n"
+    "2 1 7 8 12 XOR\n"
+    "1 1 9 13 EQW\n"
+    "1 1 1 14 EQ\n";
+
+BristolCircuit parse(const string & text)
+{
+    istringstream stream(text);
+    return BristolCircuit::read(stream);
+}
+
+
+BOOST_AUTO_TEST_SUITE(BristolCircuitSuite)
+
+BOOST_AUTO_TEST_CASE(bristol_circuit_parsing)
+{
+    const auto circuit = parse(ADDER_CIRCUIT);
+
+    BOOST_CHECK(circuit.input_sizes() == vector<size_t>({2, 2}));
+    BOOST_CHECK(circuit.output_sizes() == vector<size_t>({3, 2}));
+    BOOST_CHECK_EQUAL(circuit.wire_count(), 15);
+
+    // MAND is split into two ANDs
+    BOOST_CHECK_EQUAL(circuit.gate_count(), 11);
+    BOOST_CHECK_EQUAL(circuit.and_depth(), 2);
+
+    // Gates of one type and layer share an operation: EQ, XOR, INV, EQW at depth 0, AND and
+    // XOR at depth 1, AND and XOR at depth 2
+    BOOST_CHECK_EQUAL(circuit.batch_count(), 8);
+
+    // Malformed circuits
+    BOOST_CHECK_THROW(parse("1 3\n1 2\n1 1\n\n2 1 0 1 2 NAND\n"), precondition_not_satisfied);
+    BOOST_CHECK_THROW(parse("1 3\n1 2\n1 1\n\n2 1 0 5 2 XOR\n"), precondition_not_satisfied);
+    BOOST_CHECK_THROW(parse("2 4\n1 2\n1 1\n\n2 1 0 3 2 XOR\n2 1 0 1 3 AND\n"), precondition_not_satisfied);
+    BOOST_CHECK_THROW(parse("1 3\n1 2\n1 1\n\n1 1 0 2 XOR\n"), precondition_not_satisfied);
+    BOOST_CHECK_THROW(parse("1 3\n1 2\n"), precondition_not_satisfied);
+
+    // Sizes and wire counts that wrap around
+    BOOST_CHECK_THROW(parse("1 3\n2 18446744073709551615 1\n1 1\n\n2 1 0 1 2 XOR\n"), precondition_not_satisfied);
+    BOOST_CHECK_THROW(parse("1 3\n1 2\n2 18446744073709551615 2\n\n2 1 0 1 2 XOR\n"), precondition_not_satisfied);
+    BOOST_CHECK_THROW(parse("1 3\n18446744073709551615 1\n1 1\n\n2 1 0 1 2 XOR\n"), precondition_not_satisfied);
+    BOOST_CHECK_THROW(parse("1 3\n1 2\n1 1\n\n18446744073709551615 1 0 1 2 XOR\n"), precondition_not_satisfied);
+    BOOST_CHECK_THROW(parse("1 3\n1 2\n1 1\n\n1 18446744073709551615 0 1 2 XOR\n"), precondition_not_satisfied);
+    BOOST_CHECK_THROW(BristolCircuit::load("/nonexistent/adder.txt"), precondition_not_satisfied);
+}
+
+BOOST_AUTO_TEST_CASE(bristol_circuit_plaintext_evaluation)
+{
+    const auto circuit = parse(ADDER_CIRCUIT);
+
+    for (unsigned int a = 0; a < 4; ++a) {
+        for (unsigned int b = 0; b < 4; ++b) {
+            const auto outputs = circuit.evaluate(vector<PlaintextArray>{
+                PlaintextArray({bool(a & 1), bool(a & 2)}),
+                PlaintextArray({bool(b & 1), bool(b & 2)}),
+            });
+
+            const unsigned int sum = a + b;
+            BOOST_CHECK(outputs[0] == PlaintextArray({bool(sum & 1), bool(sum & 2), bool(sum & 4)}));
+            BOOST_CHECK(outputs[1] == PlaintextArray({!(a & 1), 1}));
+        }
+    }
+
+    // Wrong number or sizes of inputs
+    BOOST_CHECK_THROW(circuit.evaluate(vector<PlaintextArray>{PlaintextArray({0, 1})}), precondition_not_satisfied);
+    BOOST_CHECK_THROW(circuit.evaluate(vector<PlaintextArray>{PlaintextArray({0, 1}), PlaintextArray({1})}),
+                      precondition_not_satisfied);
+}
+
+BOOST_AUTO_TEST_CASE(bristol_circuit_encrypted_evaluation)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 4, 42));
+    const auto circuit = parse(ADDER_CIRCUIT);
+
+    for (unsigned int a = 0; a < 4; ++a) {
+        for (unsigned int b = 0; b < 4; ++b) {
+            const vector<PlaintextArray> plaintext_inputs = {
+                PlaintextArray({bool(a & 1), bool(a & 2)}),
+                PlaintextArray({bool(b & 1), bool(b & 2)}),
+            };
+
+            const vector<EncryptedArray> inputs = {
+                sk.encrypt(plaintext_inputs[0]).expand(),
+                sk.encrypt(plaintext_inputs[1]).expand(),
+            };
+
+            const auto expected = circuit.evaluate(plaintext_inputs);
+            const auto outputs = circuit.evaluate(inputs);
+
+            BOOST_REQUIRE_EQUAL(outputs.size(), 2);
+            BOOST_CHECK(sk.decrypt(outputs[0]) == expected[0].elements());
+            BOOST_CHECK(sk.decrypt(outputs[1]) == expected[1].elements());
+
+            // Carry goes through two multiplications
+            BOOST_CHECK_EQUAL(outputs[0].degree(), 3);
+            BOOST_CHECK_EQUAL(outputs[1].degree(), 1);
+
+            // Noise of the carry is bounded by that of a product of three inputs and a few sums
+            const double fresh = inputs[0].noise_bits();
+            BOOST_CHECK(outputs[0].noise_bits() > 3 * fresh);
+            BOOST_CHECK(outputs[0].noise_bits() < 3 * fresh + 4);
+            BOOST_CHECK(outputs[1].noise_bits() < fresh + 1);
+            BOOST_CHECK_EQUAL(outputs[0].noise_limit(), inputs[0].noise_limit());
+        }
+    }
+
+    // Batches run on the library executor
+    const vector<EncryptedArray> inputs = {sk.encrypt({1, 1}).expand(), sk.encrypt({1, 0}).expand()};
+    const auto serial_outputs = circuit.evaluate(inputs);
+
+    she::set_executor(make_shared<WorkStealingPool>(4));
+    const auto parallel_outputs = circuit.evaluate(inputs);
+    she::set_executor(nullptr);
+
+    BOOST_CHECK(parallel_outputs[0] == serial_outputs[0]);
+    BOOST_CHECK(parallel_outputs[1] == serial_outputs[1]);
+    BOOST_CHECK(sk.decrypt(parallel_outputs[0]) == vector<bool>({0, 0, 1}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
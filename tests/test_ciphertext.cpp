@@ -3,17 +3,25 @@
 #include <cstddef>
 #include <boost/test/unit_test.hpp>
 
+#include <memory>
+#include <thread>
+
 #include "she.hpp"
+#include "she/exceptions.hpp"
 #include "serialization_formats.hpp"
 
+using std::string;
 using std::stringstream;
 using std::vector;
 
+using she::precondition_not_satisfied;
 using she::PrivateKey;
+using she::PRFMode;
 using she::ParameterSet;
 using she::CompressedCiphertext;
 using she::PlaintextArray;
 using she::EncryptedArray;
+using she::EvaluationContext;
 
 
 BOOST_AUTO_TEST_SUITE(CompressedCiphertextSuite)
@@ -52,6 +60,32 @@ BOOST_AUTO_TEST_CASE(compressed_ciphertext_correct_expansion)
     BOOST_CHECK_EQUAL(restored_plaintext.size(), plaintext.size());
 }
 
+BOOST_AUTO_TEST_CASE(compressed_ciphertext_partial_expansion)
+{
+    const vector<bool> plaintext = {1, 0, 1, 0, 0, 1, 1, 1};
+    const vector<size_t> indexes = {6, 1, 0, 6, 4};
+    const vector<bool> expected_plaintext = {1, 0, 1, 1, 0};
+
+    for (const auto mode : {PRFMode::stream, PRFMode::counter}) {
+        const PrivateKey sk(ParameterSet::generate_parameter_set(42, 5, 42, mode));
+        const auto compressed_ciphertext = sk.encrypt(plaintext);
+
+        const auto expanded_ciphertext = compressed_ciphertext.expand();
+        const auto partially_expanded_ciphertext = compressed_ciphertext.expand(indexes);
+
+        BOOST_CHECK(sk.decrypt(expanded_ciphertext) == plaintext);
+        BOOST_CHECK(sk.decrypt(partially_expanded_ciphertext) == expected_plaintext);
+        BOOST_CHECK(partially_expanded_ciphertext.public_element() == expanded_ciphertext.public_element());
+
+        for (size_t i = 0; i < indexes.size(); ++i) {
+            BOOST_CHECK(partially_expanded_ciphertext.elements()[i]
+                        == expanded_ciphertext.elements()[indexes[i]]);
+        }
+
+        BOOST_CHECK_THROW(compressed_ciphertext.expand({plaintext.size()}), precondition_not_satisfied);
+    }
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE(compressed_ciphertext_serialization, Format, Formats)
 {
     const PrivateKey sk(ParameterSet::generate_parameter_set(42, 10, 42));
@@ -128,6 +162,89 @@ BOOST_AUTO_TEST_CASE(encrypted_array_empty_construction)
     const EncryptedArray a2(x, 10);
     BOOST_CHECK(a1 == a2);
     BOOST_CHECK(!(a1 != a2));
+
+    const EncryptedArray a3;
+    BOOST_CHECK_EQUAL(a3.size(), 0);
+    BOOST_CHECK_EQUAL(a3.degree(), 0);
+    BOOST_CHECK_EQUAL(a3.max_degree(), 0);
+
+    BOOST_CHECK_THROW(EncryptedArray(mpz_class(0), 10), precondition_not_satisfied);
+    BOOST_CHECK_THROW(EncryptedArray(mpz_class(-42), 10), precondition_not_satisfied);
+}
+
+BOOST_AUTO_TEST_CASE(encrypted_array_invalid_public_element_archive)
+{
+    stringstream ss;
+    {
+        const EncryptedArray array(mpz_class(1), 10);
+        xml_oarchive oa(ss);
+        oa << BOOST_SERIALIZATION_NVP(array);
+    }
+
+    auto text = ss.str();
+    const string valid_element = "<repr>1</repr>";
+    const auto position = text.find(valid_element);
+    BOOST_REQUIRE(position != string::npos);
+    text.replace(position, valid_element.size(), "<repr>0</repr>");
+
+    stringstream invalid_ss(text);
+    xml_iarchive ia(invalid_ss);
+    EncryptedArray array;
+    BOOST_CHECK_THROW(ia >> BOOST_SERIALIZATION_NVP(array), precondition_not_satisfied);
+}
+
+BOOST_AUTO_TEST_CASE(encrypted_array_shared_evaluation_context)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    const auto compressed_ciphertext = sk.encrypt({1, 0, 1});
+    const auto a1 = compressed_ciphertext.expand();
+    const auto a2 = sk.encrypt({0, 1, 1}).expand();
+
+    // All arrays under the same public element share one context
+    BOOST_REQUIRE(a1.context());
+    BOOST_CHECK(a1.context() == a2.context());
+    BOOST_CHECK(a1.context() == (a1 & a2).context());
+    BOOST_CHECK(a1.context() == EncryptedArray(a1.public_element(), 5).context());
+    BOOST_CHECK(a1.context()->public_element() == a1.public_element());
+
+    // Context is freed with the last array using it
+    const mpz_class x = 1000003;
+    std::weak_ptr<const EvaluationContext> released_context;
+    {
+        const EncryptedArray a3(x, 5);
+        const auto a4 = a3 ^ a3;
+        released_context = a4.context();
+        BOOST_CHECK(!released_context.expired());
+    }
+    BOOST_CHECK(released_context.expired());
+
+    const EncryptedArray a5(x, 5);
+    BOOST_CHECK(a5.public_element() == x);
+}
+
+BOOST_AUTO_TEST_CASE(encrypted_array_concurrent_construction)
+{
+    const vector<mpz_class> public_elements = {1000003, 1000033, 1000037};
+
+    vector<std::thread> threads;
+    vector<vector<EncryptedArray>> arrays(4);
+    for (auto & thread_arrays : arrays) {
+        threads.emplace_back([&public_elements, &thread_arrays]() {
+            for (size_t i = 0; i < 300; ++i) {
+                thread_arrays.emplace_back(public_elements[i % public_elements.size()], 5);
+            }
+        });
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    for (const auto & thread_arrays : arrays) {
+        for (size_t i = 0; i < thread_arrays.size(); ++i) {
+            BOOST_CHECK(thread_arrays[i].context() == arrays[0][i].context());
+        }
+    }
 }
 
 BOOST_AUTO_TEST_CASE_TEMPLATE(encrypted_array_serialization, Format, Formats)
@@ -148,6 +265,8 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(encrypted_array_serialization, Format, Formats)
     }
 
     BOOST_CHECK(array == restored_array);
+    BOOST_CHECK_EQUAL(restored_array.noise_bits(), array.noise_bits());
+    BOOST_CHECK_EQUAL(restored_array.noise_limit(), array.noise_limit());
 }
 
 BOOST_AUTO_TEST_CASE(encrypted_arrays_extend_empty)
@@ -0,0 +1,330 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE CircuitModule
+#include <cstddef>
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+
+#include "she.hpp"
+#include "she/circuit.hpp"
+#include "she/exceptions.hpp"
+#include "she/parallel.hpp"
+
+using std::make_shared;
+using std::vector;
+
+using she::precondition_not_satisfied;
+using she::PrivateKey;
+using she::ParameterSet;
+using she::PlaintextArray;
+using she::EncryptedArray;
+using she::Circuit;
+using she::Expression;
+using she::ThreadPool;
+using she::WorkStealingPool;
+
+
+BOOST_AUTO_TEST_SUITE(CircuitSuite)
+
+BOOST_AUTO_TEST_CASE(circuit_evaluation)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    const vector<bool> raw_a = {1, 0, 1, 1};
+    const vector<bool> raw_b = {0, 1, 1, 0, 1};
+    const vector<bool> raw_p = {1, 1, 0, 0};
+
+    const auto a = sk.encrypt(raw_a).expand();
+    const auto b = sk.encrypt(raw_b).expand();
+    const PlaintextArray p(raw_p);
+
+    Circuit circuit;
+    const auto x = circuit.input(a);
+    const auto y = circuit.input(b);
+
+    const auto sum = (x ^ y) ^ p;
+    const auto product = (x & y) & p;
+    const auto comparison = x.equal({y, x, circuit.constant(raw_a)});
+    const auto selection = comparison.select({x, y, circuit.constant(raw_p)});
+
+    BOOST_CHECK_EQUAL(sum.size(), 5);
+    BOOST_CHECK_EQUAL(comparison.size(), 3);
+    BOOST_CHECK_EQUAL(selection.size(), 5);
+
+    const auto results = circuit.evaluate({sum, product, comparison, selection});
+
+    const auto eager_comparison = a.equal({b, a, sk.encrypt(raw_a).expand()});
+    const auto eager_selection = eager_comparison.select({a, b, sk.encrypt(raw_p).expand()});
+
+    BOOST_CHECK(sk.decrypt(results[0]) == sk.decrypt((a ^ b) ^ p));
+    BOOST_CHECK(sk.decrypt(results[1]) == sk.decrypt((a & b) & p));
+    BOOST_CHECK(sk.decrypt(results[2]) == sk.decrypt(eager_comparison));
+    BOOST_CHECK(sk.decrypt(results[3]) == sk.decrypt(eager_selection));
+
+    BOOST_CHECK(sk.decrypt(results[2]) == vector<bool>({0, 1, 1}));
+    BOOST_CHECK_EQUAL(results[1].degree(), 2);
+
+    // Inputs are not modified by evaluation
+    BOOST_CHECK(sk.decrypt(circuit.evaluate(x)) == raw_a);
+}
+
+BOOST_AUTO_TEST_CASE(circuit_common_subexpressions)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    Circuit circuit;
+    const auto x = circuit.input(sk.encrypt({1, 0, 1}).expand());
+    const auto y = circuit.input(sk.encrypt({1, 1, 0}).expand());
+
+    const auto first = (x & y) ^ x;
+    const size_t size = circuit.size();
+
+    // Same operations in another order record no new nodes
+    const auto second = x ^ (y & x);
+    BOOST_CHECK_EQUAL(circuit.size(), size);
+    BOOST_CHECK_EQUAL(first.node(), second.node());
+
+    // Same constants are recorded once
+    const auto p = circuit.constant(PlaintextArray({1, 0}));
+    const auto q = circuit.constant(PlaintextArray({1, 0}));
+    BOOST_CHECK_EQUAL(p.node(), q.node());
+
+    // Inputs are always new nodes
+    const auto z = circuit.input(sk.encrypt({1, 0, 1}).expand());
+    BOOST_CHECK(z.node() != x.node());
+}
+
+BOOST_AUTO_TEST_CASE(circuit_constant_folding)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    Circuit circuit;
+    const auto x = circuit.input(sk.encrypt({1, 0, 1, 1}).expand());
+    const auto p = circuit.constant(PlaintextArray({1, 0, 1}));
+    const auto q = circuit.constant(PlaintextArray({0, 1, 1}));
+
+    // Operations on constants are constants
+    const size_t size = circuit.size();
+    const auto folded = (p ^ q).select({p, q & p}) ^ p.equal({q, p});
+    BOOST_CHECK_EQUAL(folded.size(), 3);
+
+    const auto expected = (PlaintextArray({1, 0, 1}) ^ PlaintextArray({0, 1, 1})).select({
+        PlaintextArray({1, 0, 1}),
+        PlaintextArray({0, 1, 1}) & PlaintextArray({1, 0, 1})
+    }) ^ PlaintextArray({1, 0, 1}).equal({PlaintextArray({0, 1, 1}), PlaintextArray({1, 0, 1})});
+
+    BOOST_CHECK(folded.node() == circuit.constant(expected).node());
+    BOOST_CHECK(sk.decrypt(circuit.evaluate(folded)) == expected.elements());
+
+    // Operations that leave the operand as it is
+    BOOST_CHECK_EQUAL((x & x).node(), x.node());
+    BOOST_CHECK_EQUAL((x ^ PlaintextArray({0, 0})).node(), x.node());
+    BOOST_CHECK_EQUAL((x & PlaintextArray({1, 1, 1, 1})).node(), x.node());
+
+    // Operations that do not depend on the operand
+    const auto zeros = x ^ x;
+    BOOST_CHECK(sk.decrypt(circuit.evaluate(zeros)) == vector<bool>(4, 0));
+    BOOST_CHECK(sk.decrypt(circuit.evaluate(x & PlaintextArray(vector<bool>(5, 0)))) == vector<bool>(5, 0));
+
+    // Constants shorter or longer than the operand are not folded away
+    BOOST_CHECK(sk.decrypt(circuit.evaluate(x & PlaintextArray({0, 1}))) == vector<bool>({0, 0, 1, 1}));
+    BOOST_CHECK(sk.decrypt(circuit.evaluate(x ^ PlaintextArray({0, 0, 0, 0, 0, 1}))) == vector<bool>({1, 0, 1, 1, 0, 1}));
+
+    BOOST_CHECK(circuit.size() > size);
+}
+
+BOOST_AUTO_TEST_CASE(circuit_depth_reordering)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    vector<vector<bool>> raw_inputs;
+    for (size_t i = 0; i < 8; ++i) {
+        raw_inputs.push_back({1, (i % 3) != 0, 1});
+    }
+
+    Circuit circuit;
+    vector<Expression> inputs;
+    for (const auto & raw_input : raw_inputs) {
+        inputs.push_back(circuit.input(sk.encrypt(raw_input).expand()));
+    }
+
+    // Chain of multiplications, one after another
+    auto product = inputs[0];
+    for (size_t i = 1; i < inputs.size(); ++i) {
+        product &= inputs[i];
+    }
+    BOOST_CHECK_EQUAL(circuit.depth(product), 7);
+
+    circuit.optimize({product});
+    BOOST_CHECK_EQUAL(circuit.depth(product), 3);
+
+    // Products used elsewhere are factors of a chain, not part of it
+    const auto partial = inputs[0] & inputs[1] & inputs[2];
+    const auto shared = partial ^ inputs[3];
+
+    auto extended = partial & inputs[4] & inputs[5] & inputs[6];
+    extended &= inputs[7];
+    BOOST_CHECK_EQUAL(circuit.depth(extended), 6);
+
+    circuit.optimize({product, shared, extended});
+    BOOST_CHECK_EQUAL(circuit.depth(product), 3);
+    BOOST_CHECK_EQUAL(circuit.depth(shared), 2);
+    BOOST_CHECK_EQUAL(circuit.depth(extended), 3);
+
+    const auto results = circuit.evaluate({product, shared, extended});
+
+    BOOST_CHECK(sk.decrypt(results[0]) == vector<bool>({1, 0, 1}));
+    BOOST_CHECK_EQUAL(results[0].degree(), 8);
+
+    vector<bool> expected(3);
+    for (size_t j = 0; j < 3; ++j) {
+        expected[j] = (raw_inputs[0][j] & raw_inputs[1][j] & raw_inputs[2][j]) ^ raw_inputs[3][j];
+    }
+    BOOST_CHECK(sk.decrypt(results[1]) == expected);
+
+    BOOST_CHECK(sk.decrypt(results[2]) == vector<bool>({1, 0, 1}));
+    BOOST_CHECK_EQUAL(results[2].degree(), 7);
+}
+
+BOOST_AUTO_TEST_CASE(circuit_common_subexpressions_after_rebalancing)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    Circuit circuit;
+    vector<Expression> inputs;
+    for (size_t i = 0; i < 4; ++i) {
+        inputs.push_back(circuit.input(sk.encrypt({1, i != 2, 1}).expand()));
+    }
+
+    const auto chain = ((inputs[0] & inputs[1]) & inputs[2]) & inputs[3];
+    const auto result = circuit.evaluate(chain);
+    BOOST_CHECK(sk.decrypt(result) == vector<bool>({1, 0, 1}));
+
+    // Chain is now computed as a balanced tree, which is found again when recorded
+    const size_t size = circuit.size();
+    const auto balanced = (inputs[0] & inputs[1]) & (inputs[2] & inputs[3]);
+    BOOST_CHECK_EQUAL(circuit.size(), size);
+    BOOST_CHECK_EQUAL(circuit.depth(balanced), 2);
+
+    const auto results = circuit.evaluate({chain, balanced});
+    BOOST_CHECK(results[0] == results[1]);
+}
+
+BOOST_AUTO_TEST_CASE(circuit_invalid_expressions)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const auto a = sk.encrypt({1, 0, 1}).expand();
+    const PlaintextArray p({1, 1, 0});
+
+    Circuit circuit;
+    Circuit other_circuit;
+    auto x = circuit.input(a);
+    const auto y = other_circuit.input(a);
+
+    // Expressions of different circuits
+    BOOST_CHECK_THROW(x ^= y, precondition_not_satisfied);
+    BOOST_CHECK_THROW(x &= y, precondition_not_satisfied);
+    BOOST_CHECK_THROW(x.equal({y}), precondition_not_satisfied);
+    BOOST_CHECK_THROW(x.select({y}), precondition_not_satisfied);
+    BOOST_CHECK_THROW(circuit.depth(y), precondition_not_satisfied);
+    BOOST_CHECK_THROW(circuit.optimize({y}), precondition_not_satisfied);
+    BOOST_CHECK_THROW(circuit.evaluate(y), precondition_not_satisfied);
+
+    // Expressions that were never assigned
+    Expression empty;
+    BOOST_CHECK_THROW(empty ^= x, precondition_not_satisfied);
+    BOOST_CHECK_THROW(empty ^= p, precondition_not_satisfied);
+    BOOST_CHECK_THROW(empty &= x, precondition_not_satisfied);
+    BOOST_CHECK_THROW(empty &= p, precondition_not_satisfied);
+    BOOST_CHECK_THROW(empty.equal({x}), precondition_not_satisfied);
+    BOOST_CHECK_THROW(empty.select({x}), precondition_not_satisfied);
+    BOOST_CHECK_THROW(empty.size(), precondition_not_satisfied);
+    BOOST_CHECK_THROW(circuit.depth(empty), precondition_not_satisfied);
+
+    // Inputs that are not initialized
+    BOOST_CHECK_THROW(circuit.input(EncryptedArray()), precondition_not_satisfied);
+}
+
+BOOST_AUTO_TEST_CASE(circuit_parallel_evaluation)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    vector<vector<bool>> raw_inputs;
+    for (size_t i = 0; i < 16; ++i) {
+        raw_inputs.push_back({i % 2 == 0, i % 3 == 0, 1, i % 5 == 0});
+    }
+
+    Circuit circuit;
+    vector<Expression> inputs;
+    for (const auto & raw_input : raw_inputs) {
+        inputs.push_back(circuit.input(sk.encrypt(raw_input).expand()));
+    }
+
+    // Independent sums of pairwise products, and a comparison of all of them
+    vector<Expression> sums;
+    for (size_t i = 0; i + 3 < inputs.size(); i += 4) {
+        sums.push_back((inputs[i] & inputs[i + 1]) ^ (inputs[i + 2] & inputs[i + 3]));
+    }
+    const auto comparison = sums[0].equal(sums);
+    const auto selection = comparison.select(sums);
+
+    const vector<Expression> outputs = {sums[0], sums[3], comparison, selection};
+    const auto serial_results = circuit.evaluate(outputs);
+
+    for (const auto & executor : vector<std::shared_ptr<she::Executor>>{
+            make_shared<ThreadPool>(4), make_shared<WorkStealingPool>(4)}) {
+        she::set_executor(executor);
+        const auto parallel_results = circuit.evaluate(outputs);
+        she::set_executor(nullptr);
+
+        BOOST_REQUIRE_EQUAL(parallel_results.size(), serial_results.size());
+        for (size_t i = 0; i < serial_results.size(); ++i) {
+            BOOST_CHECK(parallel_results[i] == serial_results[i]);
+            BOOST_CHECK_EQUAL(parallel_results[i].degree(), serial_results[i].degree());
+        }
+    }
+
+    vector<vector<bool>> expected_sums;
+    for (size_t i = 0; i + 3 < raw_inputs.size(); i += 4) {
+        vector<bool> expected_sum(4);
+        for (size_t j = 0; j < 4; ++j) {
+            expected_sum[j] = (raw_inputs[i][j] & raw_inputs[i + 1][j]) ^ (raw_inputs[i + 2][j] & raw_inputs[i + 3][j]);
+        }
+        expected_sums.push_back(expected_sum);
+    }
+
+    BOOST_CHECK(sk.decrypt(serial_results[0]) == expected_sums[0]);
+    BOOST_CHECK(sk.decrypt(serial_results[1]) == expected_sums[3]);
+    for (size_t i = 0; i < expected_sums.size(); ++i) {
+        BOOST_CHECK_EQUAL(sk.decrypt(serial_results[2])[i], expected_sums[i] == expected_sums[0]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(circuit_frees_intermediates)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    Circuit circuit;
+    const auto x = circuit.input(sk.encrypt({1, 0, 1}).expand());
+    const auto y = circuit.input(sk.encrypt({0, 1, 1}).expand());
+
+    // Long chain of additions, each step is used once by the next one. Inputs and constants
+    // cancel out except for one y
+    auto chain = x;
+    for (size_t i = 0; i < 50; ++i) {
+        chain ^= (i % 2 == 0) ? y : x;
+        chain ^= PlaintextArray({1, 1, 0});
+    }
+
+    const auto result = circuit.evaluate(chain);
+    BOOST_CHECK(sk.decrypt(result) == vector<bool>({0, 1, 1}));
+    BOOST_CHECK(circuit.size() > 100);
+    BOOST_CHECK(circuit.peak_values() <= 2);
+
+    she::set_executor(make_shared<WorkStealingPool>(4));
+    BOOST_CHECK(sk.decrypt(circuit.evaluate(chain)) == vector<bool>({0, 1, 1}));
+    BOOST_CHECK(circuit.peak_values() <= 2);
+    she::set_executor(nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
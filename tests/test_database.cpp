@@ -0,0 +1,240 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE DatabaseModule
+#include <cstddef>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "she.hpp"
+#include "she/database.hpp"
+#include "she/exceptions.hpp"
+
+using std::string;
+using std::vector;
+
+using she::precondition_not_satisfied;
+using she::PrivateKey;
+using she::ParameterSet;
+using she::PlaintextArray;
+using she::EncryptedArray;
+using she::RecordSource;
+using she::VectorRecordSource;
+using she::PackedRecordFile;
+using she::PlaintextDatabase;
+
+
+string temporary_path()
+{
+    char path[] = "/tmp/she_database_XXXXXX";
+    const int fd = mkstemp(path);
+    close(fd);
+    return path;
+}
+
+
+BOOST_AUTO_TEST_SUITE(RecordSourceSuite)
+
+BOOST_AUTO_TEST_CASE(packed_record_file_roundtrip)
+{
+    const auto path = temporary_path();
+
+    const vector<PlaintextArray> records = {
+        PlaintextArray({1, 0, 1, 1, 0, 0, 0, 0, 1, 1}),
+        PlaintextArray({0, 1}),
+        PlaintextArray(vector<bool>{}),
+        PlaintextArray({1, 1, 1, 1, 1, 1, 1, 1, 1, 1}),
+    };
+
+    VectorRecordSource source(records);
+    PackedRecordFile::write(path, source, 10);
+
+    PackedRecordFile file(path);
+    BOOST_CHECK_EQUAL(file.size(), records.size());
+    BOOST_CHECK_EQUAL(file.record_size(), 10);
+
+    for (size_t pass = 0; pass < 2; ++pass) {
+        PlaintextArray record;
+        for (const auto & expected : records) {
+            BOOST_REQUIRE(file.next(record));
+
+            // Records are padded with zeros
+            auto padded = expected.elements();
+            padded.resize(10, 0);
+            BOOST_CHECK(record.elements() == padded);
+        }
+        BOOST_CHECK(!file.next(record));
+
+        file.rewind();
+    }
+
+    // Records larger than the record size
+    VectorRecordSource large_source(records);
+    BOOST_CHECK_THROW(PackedRecordFile::write(path, large_source, 5), precondition_not_satisfied);
+
+    // Headers whose sizes wrap around to the size of the file: 2^44 records of 2^20 bytes, and
+    // records so large that rounding them up to bytes wraps to zero
+    const auto write_header = [&](uint64_t count, uint64_t record_size) {
+        VectorRecordSource empty_source(vector<PlaintextArray>{});
+        PackedRecordFile::write(path, empty_source, 10);
+
+        PackedRecordFile::Header header;
+        std::ifstream(path, std::ios::binary).read(reinterpret_cast<char *>(&header), sizeof(header));
+        header.count = count;
+        header.record_size = record_size;
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char *>(&header), sizeof(header));
+    };
+
+    write_header(uint64_t(1) << 44, uint64_t(1) << 23);
+    BOOST_CHECK_THROW(PackedRecordFile{path}, precondition_not_satisfied);
+
+    write_header(1, uint64_t(-3));
+    BOOST_CHECK_THROW(PackedRecordFile{path}, precondition_not_satisfied);
+
+    // Empty files of any record size are valid
+    write_header(0, 10);
+    PackedRecordFile empty_file(path);
+    PlaintextArray empty_record;
+    BOOST_CHECK(!empty_file.next(empty_record));
+
+    // Not a record file
+    std::ofstream(path) << string(1024, 'x');
+    BOOST_CHECK_THROW(PackedRecordFile{path}, precondition_not_satisfied);
+
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(select_from_record_source)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const auto path = temporary_path();
+
+    // More records than fit into one block
+    vector<PlaintextArray> records;
+    for (size_t i = 0; i < 300; ++i) {
+        vector<bool> bits(9);
+        for (size_t j = 0; j < bits.size(); ++j) {
+            bits[j] = ((i * 7 + j * 3) % 5) < 2;
+        }
+        bits.resize(5 + i % 5);
+        records.push_back(PlaintextArray(bits));
+    }
+
+    VectorRecordSource source(records);
+    PackedRecordFile::write(path, source, 9);
+
+    for (const size_t index : {0, 1, 255, 256, 299}) {
+        vector<bool> raw_selector(records.size(), 0);
+        raw_selector[index] = 1;
+        const auto selector = sk.encrypt(raw_selector).expand();
+
+        PackedRecordFile file(path);
+        const auto result = selector.select(file);
+
+        auto expected = records[index].elements();
+        expected.resize(9, 0);
+        BOOST_CHECK(sk.decrypt(result) == expected);
+        BOOST_CHECK_EQUAL(result.degree(), selector.degree());
+
+        // Same result as selecting from records in memory
+        VectorRecordSource memory_source(records);
+        BOOST_CHECK(selector.select(memory_source) == selector.select(records));
+    }
+
+    // Selector shorter than the database, remaining records are not read
+    const auto short_selector = sk.encrypt({0, 1}).expand();
+    PackedRecordFile file(path);
+    const auto short_result = short_selector.select(file);
+
+    auto expected = records[1].elements();
+    expected.resize(9, 0);
+    BOOST_CHECK(sk.decrypt(short_result) == expected);
+
+    PlaintextArray record;
+    BOOST_CHECK(file.next(record));
+
+    expected = records[2].elements();
+    expected.resize(9, 0);
+    BOOST_CHECK(record.elements() == expected);
+
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_SUITE(PlaintextDatabaseSuite)
+
+BOOST_AUTO_TEST_CASE(plaintext_database_transposition)
+{
+    // Longer records appear later, and the last word is partially filled
+    vector<PlaintextArray> records;
+    for (size_t i = 0; i < 150; ++i) {
+        vector<bool> bits(1 + i / 10);
+        for (size_t j = 0; j < bits.size(); ++j) {
+            bits[j] = ((i * 3 + j * 5) % 4) == 0;
+        }
+        records.push_back(PlaintextArray(bits));
+    }
+
+    const PlaintextDatabase database(records);
+    BOOST_CHECK_EQUAL(database.size(), records.size());
+    BOOST_CHECK_EQUAL(database.record_size(), 15);
+    BOOST_CHECK_EQUAL(database.column_words(), 3);
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        auto expected = records[i].elements();
+        expected.resize(15, 0);
+        BOOST_CHECK(database.record(i).elements() == expected);
+    }
+    BOOST_CHECK_THROW(database.record(records.size()), precondition_not_satisfied);
+
+    // Bit j of record i is bit i of column j
+    for (size_t j = 0; j < database.record_size(); ++j) {
+        for (size_t i = 0; i < records.size(); ++i) {
+            const bool bit = (database.column(j)[i / 64] >> (i % 64)) & 1;
+            BOOST_CHECK_EQUAL(bit, j < records[i].size() && records[i].elements()[j]);
+        }
+    }
+
+    VectorRecordSource source(records);
+    const PlaintextDatabase streamed_database(source);
+    BOOST_CHECK_EQUAL(streamed_database.size(), records.size());
+    BOOST_CHECK(streamed_database.record(149) == database.record(149));
+}
+
+BOOST_AUTO_TEST_CASE(plaintext_database_select)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    vector<PlaintextArray> records;
+    for (size_t i = 0; i < 130; ++i) {
+        vector<bool> bits(7);
+        for (size_t j = 0; j < bits.size(); ++j) {
+            bits[j] = ((i * 7 + j * 3) % 5) < 2;
+        }
+        records.push_back(PlaintextArray(bits));
+    }
+    const PlaintextDatabase database(records);
+
+    for (const size_t index : {0, 63, 64, 129}) {
+        vector<bool> raw_selector(records.size(), 0);
+        raw_selector[index] = 1;
+        const auto selector = sk.encrypt(raw_selector).expand();
+
+        const auto result = selector.select(database);
+
+        BOOST_CHECK(sk.decrypt(result) == records[index].elements());
+        BOOST_CHECK(result == selector.select(records));
+        BOOST_CHECK_EQUAL(result.degree(), selector.degree());
+    }
+
+    // Selector shorter than the database
+    const auto short_selector = sk.encrypt({0, 0, 1}).expand();
+    BOOST_CHECK(sk.decrypt(short_selector.select(database)) == records[2].elements());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,11 +3,15 @@
 #include <cstddef>
 #include <boost/test/unit_test.hpp>
 
+#include <cmath>
+
 #include "she.hpp"
+#include "she/exceptions.hpp"
 #include "serialization_formats.hpp"
 
 using std::vector;
 
+using she::precondition_not_satisfied;
 using she::PrivateKey;
 using she::ParameterSet;
 using she::CompressedCiphertext;
@@ -145,6 +149,169 @@ BOOST_AUTO_TEST_CASE(multiple_arrays_sum)
     }
 }
 
+BOOST_AUTO_TEST_CASE(lazy_reduction)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const unsigned int headroom_bits = 4;
+
+    vector<vector<bool> > inputs;
+    vector<bool> expected_result(8, 0);
+    for (size_t i = 0; i < 40; ++i) {
+        vector<bool> input;
+        for (size_t j = 0; j < 8; ++j) {
+            input.push_back((i * 7 + j * 3) % 5 < 2);
+            expected_result[j] = expected_result[j] ^ input[j];
+        }
+        inputs.push_back(input);
+    }
+
+    vector<EncryptedArray> encrypted_inputs;
+    for (const auto & input : inputs) {
+        encrypted_inputs.push_back(sk.encrypt(input).expand());
+    }
+
+    const auto eager_result = sum(encrypted_inputs);
+
+    encrypted_inputs.front().set_lazy_reduction(headroom_bits);
+    auto lazy_result = sum(encrypted_inputs);
+
+    BOOST_CHECK_EQUAL(lazy_result.lazy_reduction(), headroom_bits);
+
+    const auto public_element_bits = mpz_sizeinbase(lazy_result.public_element().get_mpz_t(), 2);
+    for (const auto & element : lazy_result.elements()) {
+        BOOST_CHECK_LE(mpz_sizeinbase(element.get_mpz_t(), 2), public_element_bits + headroom_bits);
+    }
+
+    BOOST_CHECK(sk.decrypt(lazy_result) == expected_result);
+    BOOST_CHECK(sk.decrypt(eager_result) == expected_result);
+
+    {
+        // Serialized representation is normalized
+        EncryptedArray restored_result;
+
+        std::stringstream ss;
+        {
+            boost::archive::text_oarchive oa(ss);
+            oa << BOOST_SERIALIZATION_NVP(lazy_result);
+        }
+        {
+            boost::archive::text_iarchive ia(ss);
+            ia >> BOOST_SERIALIZATION_NVP(restored_result);
+        }
+
+        BOOST_CHECK(restored_result == eager_result);
+    }
+
+    lazy_result.normalize();
+    BOOST_CHECK(lazy_result == eager_result);
+}
+
+BOOST_AUTO_TEST_CASE(noise_tracking)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const auto & params = sk.parameter_set();
+
+    // Noise of every element is at most 2^noise_bits
+    const auto check_bound = [&](const EncryptedArray & array) {
+        const mpz_class bound = mpz_class(1) << static_cast<unsigned long>(std::ceil(array.noise_bits()));
+        for (const auto & element : array.elements()) {
+            BOOST_CHECK(element % sk.private_element() <= bound);
+        }
+    };
+
+    const auto a = sk.encrypt({1, 0, 1, 0, 1, 1, 1, 1}).expand();
+    const auto b = sk.encrypt({1, 1, 0, 0, 1, 0, 1, 0}).expand();
+    const PlaintextArray ones(vector<bool>(8, 1));
+
+    const double fresh = a.noise_bits();
+    BOOST_CHECK_CLOSE(fresh, params.noise_size_bits + 1, 0.001);
+    BOOST_CHECK_EQUAL(a.noise_limit(), params.private_key_size_bits - 1);
+    BOOST_CHECK_CLOSE(a.noise_budget(), a.noise_limit() - fresh, 0.001);
+    check_bound(a);
+
+    // Sums add a bit per doubling of terms, products add up the bits of the factors
+    const auto a_xor_b = a ^ b;
+    BOOST_CHECK_CLOSE(a_xor_b.noise_bits(), fresh + 1, 0.001);
+    check_bound(a_xor_b);
+
+    const auto a_and_b = a & b;
+    BOOST_CHECK_CLOSE(a_and_b.noise_bits(), 2 * fresh, 0.001);
+    BOOST_CHECK(a_and_b.noise_budget() < a.noise_budget());
+    check_bound(a_and_b);
+
+    // Constants add at most one to the noise and never multiply it
+    const auto a_xor_ones = a ^ ones;
+    BOOST_CHECK(a_xor_ones.noise_bits() > fresh);
+    BOOST_CHECK_CLOSE(a_xor_ones.noise_bits(), fresh, 0.001);
+    BOOST_CHECK_EQUAL((a & ones).noise_bits(), fresh);
+
+    const auto cube = (a_and_b ^ ones) & a;
+    BOOST_CHECK_CLOSE(cube.noise_bits(), 3 * fresh, 0.001);
+    check_bound(cube);
+
+    // Lazy reduction does not change the noise
+    vector<EncryptedArray> encrypted_inputs(40, a);
+    const auto eager_sum = sum(encrypted_inputs);
+    encrypted_inputs.front().set_lazy_reduction(4);
+    const auto lazy_sum = sum(encrypted_inputs);
+
+    BOOST_CHECK_EQUAL(lazy_sum.noise_bits(), eager_sum.noise_bits());
+    BOOST_CHECK_CLOSE(eager_sum.noise_bits(), fresh + std::log2(40.0), 0.001);
+    check_bound(eager_sum);
+
+    // Arrays filled in by hand have no known limit
+    EncryptedArray unknown(a.context(), a.max_degree());
+    BOOST_CHECK_EQUAL(unknown.noise_limit(), 0);
+    BOOST_CHECK(std::isinf(unknown.noise_budget()));
+
+    // Hard check passes operations within the limit
+    BOOST_CHECK(!she::noise_check());
+    she::set_noise_check(true);
+    const auto checked = product(vector<EncryptedArray>(4, a));
+    she::set_noise_check(false);
+
+    BOOST_CHECK_CLOSE(checked.noise_bits(), 4 * fresh, 0.001);
+    BOOST_CHECK(sk.decrypt(checked) == vector<bool>({1, 0, 1, 0, 1, 1, 1, 1}));
+}
+
+BOOST_AUTO_TEST_CASE(noise_check_refuses_evaluation)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 3, 42));
+    const vector<bool> plaintext = {1, 0, 1, 1};
+
+    auto array = sk.encrypt(plaintext).expand();
+
+    she::set_noise_check(true);
+
+    // Squaring doubles the noise until the budget runs out
+    size_t squarings = 0;
+    try {
+        while (true) {
+            array &= array;
+            ++squarings;
+        }
+    } catch (const precondition_not_satisfied &) {
+    }
+
+    BOOST_CHECK(squarings > 0);
+    BOOST_CHECK(array.noise_budget() > 0);
+    BOOST_CHECK(sk.decrypt(array) == plaintext);
+
+    // Refused operation leaves the operand unchanged
+    const auto before = array;
+    BOOST_CHECK_THROW(array &= before, precondition_not_satisfied);
+    BOOST_CHECK(array == before);
+    BOOST_CHECK_EQUAL(array.noise_bits(), before.noise_bits());
+
+    BOOST_CHECK_THROW(product(vector<EncryptedArray>(64, sk.encrypt(plaintext).expand())),
+                      precondition_not_satisfied);
+    she::set_noise_check(false);
+
+    // Without the check the operation goes through
+    array &= before;
+    BOOST_CHECK(array.noise_budget() < 0);
+}
+
 BOOST_AUTO_TEST_CASE(bitwise_and)
 {
     const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
@@ -231,6 +398,107 @@ BOOST_AUTO_TEST_CASE(bitwise_and)
     }
 }
 
+BOOST_AUTO_TEST_CASE(plaintext_operand_kernels)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    // Several words of plaintext bits, longer than the ciphertext
+    vector<bool> raw_ciphertext, raw_plaintext;
+    for (size_t i = 0; i < 150; ++i) {
+        raw_ciphertext.push_back((i * 7) % 5 < 2);
+        raw_plaintext.push_back((i * 3) % 7 < 3);
+    }
+    raw_plaintext.resize(170, 1);
+
+    vector<bool> expected_xor = raw_plaintext, expected_and = raw_plaintext;
+    for (size_t i = 0; i < raw_ciphertext.size(); ++i) {
+        expected_xor[i] = raw_ciphertext[i] ^ raw_plaintext[i];
+        expected_and[i] = raw_ciphertext[i] & raw_plaintext[i];
+    }
+
+    auto ciphertext = sk.encrypt(raw_ciphertext).expand();
+    ciphertext.normalize();
+    const PlaintextArray plaintext(raw_plaintext);
+
+    // Reduced elements stay reduced
+    const auto c_xor_p = ciphertext ^ plaintext;
+    BOOST_CHECK(sk.decrypt(c_xor_p) == expected_xor);
+    for (const auto & element : c_xor_p.elements()) {
+        BOOST_CHECK(element < c_xor_p.public_element());
+    }
+
+    // Ones keep elements as they are, zeros clear them
+    const auto c_and_p = ciphertext & plaintext;
+    BOOST_CHECK(sk.decrypt(c_and_p) == expected_and);
+    for (size_t i = 0; i < raw_ciphertext.size(); ++i) {
+        BOOST_CHECK(c_and_p.elements()[i] == (raw_plaintext[i] ? ciphertext.elements()[i] : 0));
+    }
+
+    // Repeated additions with lazy reduction
+    const unsigned int headroom_bits = 4;
+    auto lazy_result = ciphertext;
+    lazy_result.set_lazy_reduction(headroom_bits);
+    for (size_t k = 0; k < 41; ++k) {
+        lazy_result ^= plaintext;
+    }
+
+    BOOST_CHECK(sk.decrypt(lazy_result) == expected_xor);
+    const auto public_element_bits = mpz_sizeinbase(lazy_result.public_element().get_mpz_t(), 2);
+    for (const auto & element : lazy_result.elements()) {
+        BOOST_CHECK_LE(mpz_sizeinbase(element.get_mpz_t(), 2), public_element_bits + headroom_bits);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(trivial_elements_folding)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    const vector<bool> raw_short = {1, 0, 1};
+    const vector<bool> raw_long = {0, 1, 1, 0, 1, 1};
+    const vector<bool> raw_padding = {1, 1, 0, 1, 0, 1};
+
+    const auto c_short = sk.encrypt(raw_short).expand();
+    const auto c_long = sk.encrypt(raw_long).expand();
+
+    // Elements past the ciphertext are padded with plaintext bits
+    const auto padded = c_short ^ PlaintextArray(raw_padding);
+    for (size_t i = raw_short.size(); i < raw_padding.size(); ++i) {
+        BOOST_CHECK(padded.elements()[i] == raw_padding[i]);
+    }
+
+    // Multiplication by 0 gives 0, by 1 gives the other operand
+    auto product = c_long;
+    product &= padded;
+    BOOST_CHECK_EQUAL(product.degree(), c_long.degree() + padded.degree());
+    for (size_t i = raw_short.size(); i < raw_padding.size(); ++i) {
+        BOOST_CHECK(product.elements()[i] == (raw_padding[i] ? c_long.elements()[i] : 0));
+    }
+
+    vector<bool> expected(raw_long.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        const bool p = i < raw_short.size() ? raw_short[i] ^ raw_padding[i] : raw_padding[i];
+        expected[i] = raw_long[i] & p;
+    }
+    BOOST_CHECK(sk.decrypt(product) == expected);
+
+    // Arrays of trivial elements only do not increase the degree
+    EncryptedArray trivial(c_long.context(), c_long.max_degree());
+    trivial ^= PlaintextArray(raw_padding);
+
+    const auto trivial_product = c_long & trivial;
+    BOOST_CHECK_EQUAL(trivial_product.degree(), c_long.degree());
+    BOOST_CHECK(sk.decrypt(trivial_product) == sk.decrypt(c_long & PlaintextArray(raw_padding)));
+
+    // Addition of a trivial element is an increment
+    const auto trivial_sum = c_long ^ trivial;
+    BOOST_CHECK_EQUAL(trivial_sum.degree(), c_long.degree());
+    BOOST_CHECK(sk.decrypt(trivial_sum) == (PlaintextArray(raw_long) ^ PlaintextArray(raw_padding)).elements());
+
+    // Selection from arrays with trivial elements
+    const auto selector = sk.encrypt({0, 1}).expand();
+    BOOST_CHECK(sk.decrypt(selector.select({c_long, trivial})) == raw_padding);
+}
+
 BOOST_AUTO_TEST_CASE(multiple_arrays_product)
 {
     const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
@@ -346,6 +614,73 @@ BOOST_AUTO_TEST_CASE(array_select)
     }
 }
 
+BOOST_AUTO_TEST_CASE(array_select_uneven_records)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 4, 42));
+    const vector<PlaintextArray> plaintext_arrays = {
+        PlaintextArray({1, 1}),
+        PlaintextArray({0, 1, 0, 1, 1}),
+        PlaintextArray(vector<bool>{}),
+        PlaintextArray({1, 0, 1}),
+    };
+
+    const vector<vector<bool> > expected_results = {
+        {1, 1, 0, 0, 0},
+        {0, 1, 0, 1, 1},
+        {0, 0, 0, 0, 0},
+        {1, 0, 1, 0, 0},
+    };
+
+    for (size_t i = 0; i < plaintext_arrays.size(); ++i) {
+        vector<bool> selection(plaintext_arrays.size(), 0);
+        selection[i] = 1;
+
+        const auto result = sk.encrypt(selection).expand().select(plaintext_arrays);
+
+        BOOST_CHECK_EQUAL(result.size(), 5);
+        BOOST_CHECK_EQUAL(result.degree(), 1);
+        BOOST_CHECK(sk.decrypt(result) == expected_results[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(array_select_subset_sums)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 4, 42));
+
+    // Uneven records, and a number of records that is not a multiple of the block sizes
+    vector<PlaintextArray> plaintext_arrays;
+    for (size_t i = 0; i < 21; ++i) {
+        vector<bool> bits(3 + i % 7);
+        for (size_t j = 0; j < bits.size(); ++j) {
+            bits[j] = ((i * 5 + j * 3) % 7) < 3;
+        }
+        plaintext_arrays.push_back(PlaintextArray(bits));
+    }
+
+    for (const size_t index : {0, 6, 20}) {
+        vector<bool> selection(plaintext_arrays.size(), 0);
+        selection[index] = 1;
+        const auto selector = sk.encrypt(selection).expand();
+
+        auto expected_result = plaintext_arrays[index].elements();
+        expected_result.resize(9, 0);
+
+        const auto result = selector.select(plaintext_arrays);
+
+        for (const unsigned int block_bits : {0, 1, 2, 3, 5, 8}) {
+            const auto blocked_result = selector.select(plaintext_arrays, block_bits);
+
+            BOOST_CHECK(blocked_result == result);
+            BOOST_CHECK_EQUAL(blocked_result.degree(), result.degree());
+            BOOST_CHECK(sk.decrypt(blocked_result) == expected_result);
+        }
+    }
+
+    // Superposition of several records
+    const auto selector = sk.encrypt({1, 1, 0, 1}).expand();
+    BOOST_CHECK(selector.select(plaintext_arrays, 3) == selector.select(plaintext_arrays));
+}
+
 BOOST_AUTO_TEST_CASE(array_equal)
 {
     const PrivateKey sk(ParameterSet::generate_parameter_set(22, 4, 42));
@@ -429,4 +764,79 @@ BOOST_AUTO_TEST_CASE(array_equal)
     }
 }
 
+BOOST_AUTO_TEST_CASE(array_equal_uneven_sizes)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+
+    // Shorter arrays are padded with zeros
+    const vector<vector<bool> > raw_arrays = {
+        {1, 0, 1},
+        {1, 0, 1, 0, 0},
+        {1, 0, 1, 1},
+        {1, 0},
+        {},
+    };
+
+    vector<PlaintextArray> plaintext_arrays;
+    vector<EncryptedArray> encrypted_arrays;
+    for (const auto & raw_array : raw_arrays) {
+        plaintext_arrays.push_back(PlaintextArray(raw_array));
+        encrypted_arrays.push_back(sk.encrypt(raw_array).expand());
+    }
+
+    const vector<bool> raw_input = {1, 0, 1, 0};
+    const PlaintextArray plaintext_input(raw_input);
+    const auto encrypted_input = sk.encrypt(raw_input).expand();
+
+    const vector<bool> expected_result = {1, 1, 0, 0, 0};
+
+    const auto result = encrypted_input.equal(encrypted_arrays);
+    BOOST_CHECK(sk.decrypt(result) == expected_result);
+    BOOST_CHECK(sk.decrypt(encrypted_input.equal(plaintext_arrays)) == expected_result);
+    BOOST_CHECK(sk.decrypt(plaintext_input.equal(encrypted_arrays)) == expected_result);
+    BOOST_CHECK(plaintext_input.equal(plaintext_arrays).elements() == expected_result);
+
+    // Same value as the product over the difference array
+    const auto & x = encrypted_input.public_element();
+    for (size_t i = 0; i < encrypted_arrays.size(); ++i) {
+        const auto difference = encrypted_input ^ encrypted_arrays[i];
+
+        mpz_class expected_element = 1;
+        for (const auto & element : difference.elements()) {
+            expected_element = expected_element * (element + 1) % x;
+        }
+        BOOST_CHECK(result.elements()[i] == expected_element);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(array_demux)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 3, 42));
+    const size_t index_size = 3;
+
+    vector<PlaintextArray> indexes;
+    for (size_t i = 0; i < (1 << index_size); ++i) {
+        vector<bool> index_bits;
+        for (int bit = index_size - 1; bit >= 0; --bit) {
+            index_bits.push_back((i >> bit) & 1);
+        }
+        indexes.push_back(PlaintextArray(index_bits));
+    }
+
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        vector<bool> expected_result(indexes.size(), 0);
+        expected_result[i] = 1;
+
+        const auto encrypted_index = sk.encrypt(indexes[i].elements()).expand();
+        const auto result = encrypted_index.demux();
+
+        BOOST_CHECK_EQUAL(result.size(), indexes.size());
+        BOOST_CHECK_EQUAL(result.degree(), index_size);
+        BOOST_CHECK(sk.decrypt(result) == expected_result);
+        BOOST_CHECK(sk.decrypt(encrypted_index.equal(indexes)) == expected_result);
+
+        BOOST_CHECK(indexes[i].demux().elements() == expected_result);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -12,6 +12,7 @@ using std::stringstream;
 using std::vector;
 
 using she::precondition_not_satisfied;
+using she::PRFMode;
 using she::ParameterSet;
 using she::PrivateKey;
 
@@ -34,6 +35,12 @@ BOOST_AUTO_TEST_CASE(parameter_set_construction)
         BOOST_CHECK_EQUAL(params.private_key_size_bits, 1000);
         BOOST_CHECK_EQUAL(params.ciphertext_size_bits, 100000);
         BOOST_CHECK_EQUAL(params.prf_seed, 5);
+        BOOST_CHECK(params.prf_mode == PRFMode::stream);
+    }
+
+    {
+        const ParameterSet params { 42, 100, 1000, 100000, 5, PRFMode::counter };
+        BOOST_CHECK(params.prf_mode == PRFMode::counter);
     }
 }
 
@@ -85,15 +92,17 @@ BOOST_AUTO_TEST_CASE(parameter_set_equality_comparison)
     const ParameterSet a { 42, 100, 1000, 100000, 5 };
     const ParameterSet b { 42, 100, 1000, 100000, 5 };
     const ParameterSet c { 72, 100, 1000, 100000, 5 };
+    const ParameterSet d { 42, 100, 1000, 100000, 5, PRFMode::counter };
 
     BOOST_CHECK(a == b);
     BOOST_CHECK(b != c);
     BOOST_CHECK(c != a);
+    BOOST_CHECK(d != a);
 }
 
 BOOST_AUTO_TEST_CASE_TEMPLATE(parameter_set_serialization, Format, Formats)
 {
-    const ParameterSet params { 42, 100, 1000, 100000, 5 };
+    const ParameterSet params { 42, 100, 1000, 100000, 5, PRFMode::counter };
     ParameterSet restored_params {};
 
     stringstream ss;
@@ -121,7 +130,7 @@ BOOST_AUTO_TEST_CASE(private_key_construction_accessors_and_comparison)
 
     BOOST_CHECK(sk.parameter_set() == params);
     const auto private_element_size = mpz_sizeinbase(sk.private_element().get_mpz_t(), 2);
-    // BOOST_CHECK_EQUAL(private_element_size, params.private_key_size_bits);
+    BOOST_CHECK_EQUAL(private_element_size, params.private_key_size_bits);
 
     // These should not be the same, because new private key elements are generated every time
     const PrivateKey other_sk(params);
@@ -164,6 +173,17 @@ BOOST_AUTO_TEST_CASE(private_key_encryption_decryption)
     BOOST_CHECK_EQUAL(successful_recoveries, iterations);
 }
 
+BOOST_AUTO_TEST_CASE(private_key_counter_mode_encryption_decryption)
+{
+    const auto params = ParameterSet::generate_parameter_set(42, 5, 42, PRFMode::counter);
+    const PrivateKey sk(params);
+
+    const vector<bool> plaintext = {1, 0, 1, 0, 1, 1, 1, 0};
+    const auto ciphertext = sk.encrypt(plaintext);
+
+    BOOST_CHECK(sk.decrypt(ciphertext.expand()) == plaintext);
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE(private_key_serialization, Format, Formats)
 {
     const auto params = ParameterSet::generate_parameter_set(42, 5, 42);
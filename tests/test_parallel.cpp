@@ -0,0 +1,258 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ParallelModule
+#include <cstddef>
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+#include "she.hpp"
+#include "she/parallel.hpp"
+
+using std::atomic;
+using std::make_shared;
+using std::runtime_error;
+using std::vector;
+
+using she::PrivateKey;
+using she::ParameterSet;
+using she::PlaintextArray;
+using she::EncryptedArray;
+using she::SerialExecutor;
+using she::ThreadPool;
+using she::WorkStealingPool;
+using she::TaskGraph;
+
+using she::sum;
+using she::product;
+using she::concat;
+
+
+BOOST_AUTO_TEST_SUITE(ExecutorSuite)
+
+BOOST_AUTO_TEST_CASE(executors_cover_range_exactly_once)
+{
+    SerialExecutor serial;
+    ThreadPool pool(4);
+
+    BOOST_CHECK_EQUAL(serial.concurrency(), 1);
+    BOOST_CHECK_EQUAL(pool.concurrency(), 4);
+
+    for (const size_t size : {0, 1, 3, 4, 1000}) {
+        vector<atomic<int>> serial_visits(size), pool_visits(size);
+
+        serial.parallel_for(size, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                ++serial_visits[i];
+            }
+        });
+
+        pool.parallel_for(size, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                ++pool_visits[i];
+            }
+        });
+
+        for (size_t i = 0; i < size; ++i) {
+            BOOST_CHECK_EQUAL(serial_visits[i], 1);
+            BOOST_CHECK_EQUAL(pool_visits[i], 1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(thread_pool_propagates_exceptions)
+{
+    ThreadPool pool(3);
+
+    BOOST_CHECK_THROW(
+        pool.parallel_for(10, [](size_t begin, size_t end) {
+            if (begin == 0) {
+                throw runtime_error("Failure");
+            }
+        }),
+        runtime_error);
+
+    // Pool remains usable
+    atomic<size_t> total(0);
+    pool.parallel_for(10, [&](size_t begin, size_t end) { total += end - begin; });
+    BOOST_CHECK_EQUAL(total, 10);
+}
+
+BOOST_AUTO_TEST_CASE(work_stealing_pool_loops)
+{
+    WorkStealingPool pool(4);
+    BOOST_CHECK_EQUAL(pool.concurrency(), 4);
+
+    for (const size_t size : {0, 1, 3, 4, 1000}) {
+        vector<atomic<int>> visits(size);
+
+        pool.parallel_for(size, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                ++visits[i];
+            }
+        });
+
+        for (size_t i = 0; i < size; ++i) {
+            BOOST_CHECK_EQUAL(visits[i], 1);
+        }
+    }
+
+    // Loops started from a loop body run on the same pool
+    vector<atomic<int>> nested_visits(64);
+    pool.parallel_for(8, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            pool.parallel_for(8, [&](size_t inner_begin, size_t inner_end) {
+                for (size_t j = inner_begin; j < inner_end; ++j) {
+                    ++nested_visits[8 * i + j];
+                }
+            });
+        }
+    });
+
+    for (const auto & count : nested_visits) {
+        BOOST_CHECK_EQUAL(count, 1);
+    }
+
+    BOOST_CHECK_THROW(
+        pool.parallel_for(10, [](size_t begin, size_t end) {
+            if (begin == 0) {
+                throw runtime_error("Failure");
+            }
+        }),
+        runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(task_graphs_respect_dependencies)
+{
+    // Binary tree of tasks, every task depends on its two children
+    const size_t leaves = 64;
+    TaskGraph graph;
+    graph.successors.resize(2 * leaves - 1);
+    graph.dependencies.resize(2 * leaves - 1, 0);
+    for (size_t task = 1; task < 2 * leaves - 1; ++task) {
+        graph.successors[task].push_back((task - 1) / 2);
+        ++graph.dependencies[(task - 1) / 2];
+    }
+
+    SerialExecutor serial;
+    ThreadPool thread_pool(4);
+    WorkStealingPool work_stealing_pool(4);
+
+    for (she::Executor * executor : vector<she::Executor *>{&serial, &thread_pool, &work_stealing_pool}) {
+        vector<atomic<int>> done(graph.size());
+        atomic<size_t> violations(0);
+
+        executor->run(graph, [&](size_t task) {
+            for (const size_t child : {2 * task + 1, 2 * task + 2}) {
+                if (child < graph.size() && done[child] != 1) {
+                    ++violations;
+                }
+            }
+
+            // Loops inside tasks are allowed
+            executor->parallel_for(4, [&](size_t begin, size_t end) {});
+
+            ++done[task];
+        });
+
+        BOOST_CHECK_EQUAL(violations, 0);
+        for (const auto & count : done) {
+            BOOST_CHECK_EQUAL(count, 1);
+        }
+    }
+
+    BOOST_CHECK_THROW(
+        work_stealing_pool.run(graph, [](size_t task) {
+            if (task == 5) {
+                throw runtime_error("Failure");
+            }
+        }),
+        runtime_error);
+
+    // Empty graphs are fine
+    work_stealing_pool.run(TaskGraph(), [](size_t task) {});
+}
+
+BOOST_AUTO_TEST_CASE(library_executor_nested_loops)
+{
+    she::set_executor(make_shared<ThreadPool>(4));
+    BOOST_CHECK_EQUAL(she::executor()->concurrency(), 4);
+
+    vector<atomic<int>> visits(64);
+    she::parallel_for(8, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            she::parallel_for(8, [&](size_t inner_begin, size_t inner_end) {
+                for (size_t j = inner_begin; j < inner_end; ++j) {
+                    ++visits[8 * i + j];
+                }
+            });
+        }
+    });
+
+    for (const auto & count : visits) {
+        BOOST_CHECK_EQUAL(count, 1);
+    }
+
+    she::set_executor(nullptr);
+    BOOST_CHECK_EQUAL(she::executor()->concurrency(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_operations_match_serial)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 4, 42));
+
+    const vector<vector<bool> > raw_arrays = {
+        {1, 1, 1, 1},
+        {0, 1, 0, 1},
+        {1, 0, 1},
+        {0, 0, 0, 0, 1},
+    };
+
+    vector<EncryptedArray> encrypted_arrays;
+    vector<PlaintextArray> plaintext_arrays;
+    for (const auto & raw_array : raw_arrays) {
+        encrypted_arrays.push_back(sk.encrypt(raw_array).expand());
+        plaintext_arrays.push_back(PlaintextArray(raw_array));
+    }
+
+    const auto selector = sk.encrypt({0, 1, 0, 0}).expand();
+    const auto plaintext_selector = PlaintextArray({0, 1, 0, 0});
+
+    auto evaluate = [&]() {
+        return vector<EncryptedArray> {
+            encrypted_arrays[0] ^ encrypted_arrays[1],
+            encrypted_arrays[0] & encrypted_arrays[1],
+            encrypted_arrays[2] ^ plaintext_arrays[3],
+            encrypted_arrays[3] & plaintext_arrays[0],
+            selector.equal(encrypted_arrays),
+            selector.equal(plaintext_arrays),
+            plaintext_selector.equal(encrypted_arrays),
+            selector.select(encrypted_arrays),
+            selector.select(plaintext_arrays),
+            plaintext_selector.select(encrypted_arrays),
+            sum(encrypted_arrays),
+            product(encrypted_arrays),
+            concat(encrypted_arrays),
+        };
+    };
+
+    const auto serial_results = evaluate();
+
+    she::set_executor(make_shared<ThreadPool>(4));
+    const auto parallel_results = evaluate();
+    she::set_executor(nullptr);
+
+    BOOST_REQUIRE_EQUAL(serial_results.size(), parallel_results.size());
+    for (size_t i = 0; i < serial_results.size(); ++i) {
+        BOOST_CHECK(serial_results[i] == parallel_results[i]);
+        BOOST_CHECK_EQUAL(serial_results[i].degree(), parallel_results[i].degree());
+    }
+
+    // Selection is padded to the longest array
+    const vector<bool> expected_selection = {0, 1, 0, 1, 0};
+    BOOST_CHECK(sk.decrypt(parallel_results[7]) == expected_selection);
+    BOOST_CHECK(sk.decrypt(parallel_results[8]) == expected_selection);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,6 +12,29 @@ using std::vector;
 using she::PlaintextArray;
 
 
+// Bits that cross several words, with a partially filled last word
+vector<bool> pattern_bits(size_t size, size_t seed)
+{
+    vector<bool> bits(size);
+    for (size_t i = 0; i < size; ++i) {
+        bits[i] = ((i * 7 + seed * 13) % 5) < 2;
+    }
+    return bits;
+}
+
+// Layout of PlaintextArray archives of version 0
+struct LegacyPlaintextArray
+{
+    vector<bool> _elements;
+
+    template<class Archive>
+    void serialize(Archive & ar, unsigned int const version)
+    {
+        ar & BOOST_SERIALIZATION_NVP(_elements);
+    }
+};
+
+
 BOOST_AUTO_TEST_SUITE(PlaintextArraySuite)
 
 BOOST_AUTO_TEST_CASE(plaintext_array_construction_accessors_and_comparison)
@@ -39,25 +62,43 @@ BOOST_AUTO_TEST_CASE(plaintext_array_implicit_conversions)
     BOOST_CHECK(array == raw_plaintext);
 }
 
-// FIXME: The commented code doesn't compile, but it should
 BOOST_AUTO_TEST_CASE_TEMPLATE(plaintext_array_serialization, Format, Formats)
 {
-    const vector<bool> plaintext = {1, 0, 1, 0, 1, 1, 1, 1};
-    const PlaintextArray array(plaintext);
+    const PlaintextArray array(pattern_bits(100, 3));
+
+    PlaintextArray restored_array;
+
+    stringstream ss;
+    {
+        typename Format::oarchive oa(ss);
+        oa << BOOST_SERIALIZATION_NVP(array);
+    }
+    {
+        typename Format::iarchive ia(ss);
+        ia >> BOOST_SERIALIZATION_NVP(restored_array);
+    }
+
+    BOOST_CHECK(array == restored_array);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(plaintext_array_serialization_version_0, Format, Formats)
+{
+    const auto plaintext = pattern_bits(100, 5);
+    const LegacyPlaintextArray legacy_array{plaintext};
 
     PlaintextArray restored_array;
 
-    // stringstream ss;
-    // {
-    //     typename Format::oarchive oa(ss);
-    //     oa << BOOST_SERIALIZATION_NVP(array);
-    // }
-    // {
-    //     typename Format::iarchive ia(ss);
-    //     ia >> BOOST_SERIALIZATION_NVP(restored_array);
-    // }
-
-    // BOOST_CHECK(array == restored_array);
+    stringstream ss;
+    {
+        typename Format::oarchive oa(ss);
+        oa << boost::serialization::make_nvp("array", legacy_array);
+    }
+    {
+        typename Format::iarchive ia(ss);
+        ia >> boost::serialization::make_nvp("array", restored_array);
+    }
+
+    BOOST_CHECK(restored_array == PlaintextArray(plaintext));
 }
 
 BOOST_AUTO_TEST_CASE(plaintext_arrays_extend_empty)
@@ -99,4 +140,102 @@ BOOST_AUTO_TEST_CASE(plaintext_arrays_concat)
     BOOST_CHECK(concat(plaintext_inputs) == expected_result);
 }
 
+BOOST_AUTO_TEST_CASE(plaintext_array_packed_words)
+{
+    const auto bits = pattern_bits(130, 1);
+    PlaintextArray array(bits);
+
+    BOOST_CHECK_EQUAL(array.size(), 130);
+    BOOST_CHECK_EQUAL(array.word_count(), 3);
+    BOOST_CHECK(array.elements() == bits);
+
+    for (size_t i = 0; i < bits.size(); ++i) {
+        BOOST_CHECK_EQUAL(array[i], bits[i]);
+        BOOST_CHECK_EQUAL(((array.words()[i / 64] >> (i % 64)) & 1), bits[i]);
+    }
+
+    // Bits past the size are zero
+    BOOST_CHECK_EQUAL(array.words()[2] >> 2, 0);
+
+    array.set(129, 0);
+    array.set(128, 1);
+    BOOST_CHECK(array[128] && !array[129]);
+
+    // Shrinking clears the dropped bits
+    array.resize(65).resize(130);
+    BOOST_CHECK(array == PlaintextArray(vector<bool>(bits.begin(), bits.begin() + 65)).resize(130));
+
+    // Words past the size are ignored
+    const PlaintextArray from_words({~uint64_t(0), ~uint64_t(0)}, 70);
+    BOOST_CHECK(from_words == PlaintextArray(vector<bool>(70, 1)));
+    BOOST_CHECK_EQUAL(from_words.words()[1], 0x3F);
+}
+
+BOOST_AUTO_TEST_CASE(plaintext_array_word_operations)
+{
+    // Sizes around the word and vector widths
+    for (const size_t size1 : {0, 1, 63, 64, 65, 200, 257}) {
+        for (const size_t size2 : {0, 5, 64, 129, 300}) {
+            const auto bits1 = pattern_bits(size1, 1);
+            const auto bits2 = pattern_bits(size2, 2);
+
+            // Reference results, XOR pads with zeros and AND pads with ones
+            vector<bool> expected_xor(std::max(size1, size2), 0);
+            vector<bool> expected_and(std::max(size1, size2), 1);
+            for (size_t i = 0; i < expected_xor.size(); ++i) {
+                const bool p1 = i < size1 ? bits1[i] : 0;
+                const bool p2 = i < size2 ? bits2[i] : 0;
+                expected_xor[i] = p1 ^ p2;
+                expected_and[i] = (i < size1 ? bits1[i] : 1) & (i < size2 ? bits2[i] : 1);
+            }
+
+            BOOST_CHECK((PlaintextArray(bits1) ^ PlaintextArray(bits2)).elements() == expected_xor);
+            BOOST_CHECK((PlaintextArray(bits1) & PlaintextArray(bits2)).elements() == expected_and);
+
+            auto expected_concat = bits1;
+            expected_concat.insert(expected_concat.end(), bits2.begin(), bits2.end());
+
+            PlaintextArray concatenated(bits1);
+            concatenated.extend(PlaintextArray(bits2));
+            BOOST_CHECK(concatenated.elements() == expected_concat);
+
+            BOOST_CHECK_EQUAL(PlaintextArray(bits1) == PlaintextArray(bits2), bits1 == bits2);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(plaintext_array_equal_and_select)
+{
+    const auto bits = pattern_bits(200, 1);
+    auto padded_bits = bits;
+    padded_bits.resize(300, 0);
+    auto different_bits = bits;
+    different_bits[150] = !different_bits[150];
+
+    const vector<PlaintextArray> arrays = {
+        PlaintextArray(bits),
+        PlaintextArray(padded_bits),
+        PlaintextArray(different_bits),
+        PlaintextArray(pattern_bits(70, 3)),
+    };
+
+    // Shorter array is padded with zeros
+    const auto equal = PlaintextArray(bits).equal(arrays);
+    BOOST_CHECK(equal == PlaintextArray({1, 1, 0, 0}));
+
+    // Result is as long as the longest selectable array
+    const auto selected = PlaintextArray({0, 0, 1}).select(arrays);
+    BOOST_CHECK_EQUAL(selected.size(), 300);
+
+    auto expected = different_bits;
+    expected.resize(300, 0);
+    BOOST_CHECK(selected.elements() == expected);
+
+    const auto demuxed = PlaintextArray({1, 1, 0, 1, 0, 0, 1}).demux();
+    BOOST_CHECK_EQUAL(demuxed.size(), 128);
+    for (size_t i = 0; i < demuxed.size(); ++i) {
+        BOOST_CHECK_EQUAL(demuxed[i], i == 0x69);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -0,0 +1,123 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE PlannerModule
+#include <cstddef>
+#include <boost/test/unit_test.hpp>
+
+#include <gmpxx.h>
+
+#include "she.hpp"
+#include "she/exceptions.hpp"
+#include "she/planner.hpp"
+
+using std::vector;
+
+using she::precondition_not_satisfied;
+using she::PrivateKey;
+using she::ParameterSet;
+using she::PlaintextArray;
+using she::EncryptedArray;
+using she::CircuitShape;
+using she::ParameterPlan;
+using she::plan_parameters;
+
+
+BOOST_AUTO_TEST_SUITE(PlannerSuite)
+
+BOOST_AUTO_TEST_CASE(planned_parameters)
+{
+    const CircuitShape shape = {2, 2, 3};
+    const auto plan = plan_parameters(22, shape, 42);
+    const auto & params = plan.parameter_set;
+
+    BOOST_CHECK_EQUAL(params.security, 22);
+    BOOST_CHECK_EQUAL(params.noise_size_bits, 44);
+    BOOST_CHECK_EQUAL(params.prf_seed, 42);
+
+    // Noise of 46 bits, 2 more for sums of four, doubled and 2 more bits twice
+    BOOST_CHECK_EQUAL(plan.noise_bits, 198);
+    BOOST_CHECK_EQUAL(params.private_key_size_bits, 199);
+    BOOST_CHECK_EQUAL(params.ciphertext_size_bits, 199 * 199 * 5);
+    BOOST_CHECK(params.degree() >= 4);
+
+    BOOST_CHECK_EQUAL(plan.ciphertext_bytes, (params.ciphertext_size_bits + 7) / 8);
+    BOOST_CHECK_EQUAL(plan.compressed_bytes, 25);
+    BOOST_CHECK(plan.multiplication_cost > plan.addition_cost);
+
+    // Much smaller than the generic parameters for the same number of multiplications
+    const auto generic = ParameterSet::generate_parameter_set(22, 4, 42);
+    BOOST_CHECK(5 * params.ciphertext_size_bits < generic.ciphertext_size_bits);
+
+    // Deeper and wider circuits need larger parameters
+    const auto deeper = plan_parameters(22, {3, 2, 3}, 42);
+    const auto wider = plan_parameters(22, {2, 3, 3}, 42);
+    BOOST_CHECK(deeper.parameter_set.ciphertext_size_bits > params.ciphertext_size_bits);
+    BOOST_CHECK(wider.parameter_set.ciphertext_size_bits > params.ciphertext_size_bits);
+    BOOST_CHECK(deeper.multiplication_cost > plan.multiplication_cost);
+
+    // Shallow circuits are bounded by the cost of factoring the public element
+    const auto linear = plan_parameters(80, {0, 2, 0}, 42);
+    BOOST_CHECK(linear.parameter_set.private_key_size_bits > linear.noise_bits + 1);
+
+    BOOST_CHECK_THROW(plan_parameters(0, shape, 42), precondition_not_satisfied);
+    BOOST_CHECK_THROW(plan_parameters(22, {2, 0, 3}, 42), precondition_not_satisfied);
+    BOOST_CHECK_THROW(plan_parameters(22, {40, 2, 3}, 42), precondition_not_satisfied);
+}
+
+BOOST_AUTO_TEST_CASE(planned_parameters_decrypt_worst_case)
+{
+    const auto plan = plan_parameters(22, {2, 2, 3}, 42);
+    const PrivateKey sk(plan.parameter_set);
+
+    const vector<vector<bool>> raw_inputs = {
+        {1, 1, 0, 1, 0, 1, 1, 1},
+        {1, 0, 1, 1, 1, 0, 1, 1},
+        {1, 1, 1, 0, 0, 1, 1, 1},
+        {1, 1, 0, 1, 1, 1, 0, 1},
+    };
+
+    // Four sums of four arrays, multiplied in pairs, three ones added, multiplied again and
+    // three ones added
+    vector<EncryptedArray> sums;
+    vector<PlaintextArray> plaintext_sums;
+    for (size_t i = 0; i < 4; ++i) {
+        auto sum = sk.encrypt(raw_inputs[i]).expand();
+        PlaintextArray plaintext_sum(raw_inputs[i]);
+        for (size_t j = 1; j < 4; ++j) {
+            sum ^= sk.encrypt(raw_inputs[(i + j) % 4]).expand();
+            plaintext_sum ^= PlaintextArray(raw_inputs[(i + j) % 4]);
+        }
+        sums.push_back(sum);
+        plaintext_sums.push_back(plaintext_sum);
+    }
+
+    const PlaintextArray ones(vector<bool>(8, 1));
+
+    auto left = sums[0] & sums[1];
+    auto right = sums[2] & sums[3];
+    auto plaintext_left = plaintext_sums[0] & plaintext_sums[1];
+    auto plaintext_right = plaintext_sums[2] & plaintext_sums[3];
+    for (size_t j = 0; j < 3; ++j) {
+        left ^= ones;
+        right ^= ones;
+        plaintext_left ^= ones;
+        plaintext_right ^= ones;
+    }
+
+    auto result = left & right;
+    auto plaintext_result = plaintext_left & plaintext_right;
+    for (size_t j = 0; j < 3; ++j) {
+        result ^= ones;
+        plaintext_result ^= ones;
+    }
+
+    BOOST_CHECK(sk.decrypt(result) == plaintext_result.elements());
+
+    // Noise stays below the planned bound
+    const mpz_class bound = mpz_class(1) << plan.noise_bits;
+    for (const auto & element : result.elements()) {
+        const mpz_class noise = element % sk.private_element();
+        BOOST_CHECK(noise < bound);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
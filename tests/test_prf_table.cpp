@@ -0,0 +1,151 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE PRFTableModule
+#include <cstddef>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+
+#include <unistd.h>
+
+#include <gmpxx.h>
+
+#include "she.hpp"
+#include "she/prf_table.hpp"
+#include "she/exceptions.hpp"
+
+using std::make_shared;
+using std::string;
+using std::vector;
+
+using she::precondition_not_satisfied;
+using she::PRFMode;
+using she::PRFTable;
+using she::PseudoRandomStream;
+using she::PrivateKey;
+using she::ParameterSet;
+using she::CompressedCiphertext;
+
+
+string temporary_path()
+{
+    char path[] = "/tmp/she_prf_table_XXXXXX";
+    const int fd = mkstemp(path);
+    close(fd);
+    return path;
+}
+
+
+BOOST_AUTO_TEST_SUITE(PRFTableSuite)
+
+BOOST_AUTO_TEST_CASE(prf_table_matches_streams)
+{
+    const auto path = temporary_path();
+
+    for (const auto mode : {PRFMode::stream, PRFMode::counter}) {
+        for (const unsigned int size : {1, 64, 1000}) {
+            PRFTable::write(path, size, 42, mode, 10);
+            const PRFTable table(path);
+
+            BOOST_CHECK_EQUAL(table.size(), size);
+            BOOST_CHECK_EQUAL(table.seed(), 42);
+            BOOST_CHECK(table.mode() == mode);
+            BOOST_CHECK_EQUAL(table.count(), 10);
+
+            const PseudoRandomStream stream(size, 42, mode);
+            for (size_t i = 0; i < table.count(); ++i) {
+                mpz_t storage;
+                const auto & expected = stream.next();
+                BOOST_CHECK(table[i] == expected);
+                BOOST_CHECK_EQUAL(mpz_cmp(table.view(i, storage), expected.get_mpz_t()), 0);
+            }
+
+            mpz_t storage;
+            BOOST_CHECK_THROW(table[table.count()], precondition_not_satisfied);
+            BOOST_CHECK_THROW(table.view(table.count(), storage), precondition_not_satisfied);
+        }
+    }
+
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(prf_table_rejects_invalid_files)
+{
+    const auto path = temporary_path();
+
+    BOOST_CHECK_THROW(PRFTable(path + ".missing"), precondition_not_satisfied);
+
+    // Empty file
+    BOOST_CHECK_THROW(PRFTable{path}, precondition_not_satisfied);
+
+    // Truncated table
+    PRFTable::write(path, 1000, 42, PRFMode::counter, 3);
+    truncate(path.c_str(), sizeof(PRFTable::Header) + 10);
+    BOOST_CHECK_THROW(PRFTable{path}, precondition_not_satisfied);
+
+    // Count whose table size wraps around to the size of the file. Values of 1024 bits take
+    // 2^7 bytes, so 2^57 more values wrap
+    PRFTable::write(path, 1024, 42, PRFMode::counter, 3);
+    {
+        const uint64_t count = 3 + (uint64_t(1) << 57);
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offsetof(PRFTable::Header, count));
+        file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    }
+    BOOST_CHECK_THROW(PRFTable{path}, precondition_not_satisfied);
+
+    // Not a table
+    std::ofstream(path) << string(1024, 'x');
+    BOOST_CHECK_THROW(PRFTable{path}, precondition_not_satisfied);
+
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(prf_table_attached_to_streams)
+{
+    const auto path = temporary_path();
+    const vector<bool> bits = {1, 0, 1, 1, 0};
+
+    for (const auto mode : {PRFMode::stream, PRFMode::counter}) {
+        const auto parameter_set = ParameterSet::generate_parameter_set(22, 1, 42, mode);
+        const PrivateKey sk(parameter_set);
+        const auto compressed_ciphertext = sk.encrypt(bits);
+        const auto expected = compressed_ciphertext.expand();
+
+        // Table covers the public element and only part of the elements
+        PRFTable::write(path, parameter_set.ciphertext_size_bits, parameter_set.prf_seed, mode, 4);
+        PseudoRandomStream::attach_table(make_shared<const PRFTable>(path));
+        PseudoRandomStream::reset_cache();
+
+        // Ciphertexts created from now on use the table
+        std::stringstream ss;
+        {
+            boost::archive::text_oarchive oa(ss);
+            oa << compressed_ciphertext;
+        }
+        CompressedCiphertext restored_ciphertext;
+        {
+            boost::archive::text_iarchive ia(ss);
+            ia >> restored_ciphertext;
+        }
+        const auto expanded = restored_ciphertext.expand();
+
+        BOOST_CHECK(expanded == expected);
+        BOOST_CHECK(sk.decrypt(expanded) == bits);
+
+        // Only values past the end of the table are cached
+        BOOST_CHECK_LE(PseudoRandomStream::cache().statistics().entries, bits.size() + 1 - 4);
+
+        PseudoRandomStream::detach_tables();
+    }
+
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
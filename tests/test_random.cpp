@@ -3,15 +3,27 @@
 #include <cstddef>
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <memory>
+
 #include <gmpxx.h>
 
+#include "she/exceptions.hpp"
 #include "she/random.hpp"
+#include "she/parallel.hpp"
 
+using std::atomic;
+using std::make_shared;
 using std::vector;
 using std::abs;
 
+using she::precondition_not_satisfied;
 using she::CSPRNG;
+using she::PRFCache;
+using she::PRFMode;
+using she::PseudoRandomFunction;
 using she::PseudoRandomStream;
+using she::ThreadPool;
 
 
 BOOST_AUTO_TEST_SUITE(CSPRNG_Suite)
@@ -115,9 +127,213 @@ BOOST_AUTO_TEST_CASE(prf_stream_cache_reset)
     BOOST_CHECK(nostradamus_output_copy == pythia_output);
 
     PseudoRandomStream::reset_cache();
+    BOOST_CHECK_EQUAL(PseudoRandomStream::cache().statistics().entries, 0);
+    BOOST_CHECK_EQUAL(PseudoRandomStream::cache().statistics().bytes, 0);
 
-    BOOST_CHECK(nostradamus_output_reference != pythia_output);
-    BOOST_CHECK(nostradamus_output_copy == pythia_output);
+    // Outputs already handed out are not invalidated
+    BOOST_CHECK(nostradamus_output_reference == pythia_output);
+
+    // Outputs are recomputed after the reset
+    const PseudoRandomStream oracle(10, 10);
+    BOOST_CHECK(oracle.next() == pythia_output);
+    BOOST_CHECK(nostradamus.next() == pythia.next());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_SUITE(PRFCacheSuite)
+
+BOOST_AUTO_TEST_CASE(prf_cache_lru_eviction)
+{
+    const auto value = make_shared<const mpz_class>(mpz_class(1) << 1000);
+    const auto key = [](size_t index) { return PRFCache::key_t{PRFMode::stream, 1001, 1, index}; };
+
+    PRFCache cache(0);
+    cache.insert(key(0), value);
+    const auto entry_size = [&]() {
+        PRFCache sizing_cache(1 << 20);
+        sizing_cache.insert(key(0), value);
+        return sizing_cache.statistics().bytes;
+    }();
+
+    // Zero capacity stores nothing
+    BOOST_CHECK(cache.find(key(0)) == nullptr);
+    BOOST_CHECK_EQUAL(cache.statistics().entries, 0);
+
+    cache.set_capacity(3 * entry_size);
+    BOOST_CHECK_EQUAL(cache.capacity(), 3 * entry_size);
+
+    cache.insert(key(0), value);
+    cache.insert(key(1), value);
+    cache.insert(key(2), value);
+    BOOST_CHECK_EQUAL(cache.statistics().bytes, 3 * entry_size);
+
+    // Touch the oldest entry, the next insertion evicts the second one
+    BOOST_CHECK(cache.find(key(0)) == value);
+    cache.insert(key(3), value);
+
+    BOOST_CHECK(cache.find(key(0)) != nullptr);
+    BOOST_CHECK(cache.find(key(1)) == nullptr);
+    BOOST_CHECK(cache.find(key(2)) != nullptr);
+    BOOST_CHECK(cache.find(key(3)) != nullptr);
+
+    auto statistics = cache.statistics();
+    BOOST_CHECK_EQUAL(statistics.hits, 4);
+    BOOST_CHECK_EQUAL(statistics.misses, 2);
+    BOOST_CHECK_EQUAL(statistics.evictions, 1);
+    BOOST_CHECK_EQUAL(statistics.entries, 3);
+    BOOST_CHECK_LE(statistics.bytes, cache.capacity());
+
+    // Shrinking the budget evicts right away
+    cache.set_capacity(entry_size);
+    statistics = cache.statistics();
+    BOOST_CHECK_EQUAL(statistics.entries, 1);
+    BOOST_CHECK_EQUAL(statistics.evictions, 3);
+
+    cache.reset_statistics();
+    statistics = cache.statistics();
+    BOOST_CHECK_EQUAL(statistics.hits, 0);
+    BOOST_CHECK_EQUAL(statistics.misses, 0);
+    BOOST_CHECK_EQUAL(statistics.entries, 1);
+
+    cache.clear();
+    BOOST_CHECK_EQUAL(cache.statistics().bytes, 0);
+}
+
+BOOST_AUTO_TEST_CASE(prf_stream_output_without_cache)
+{
+    auto & cache = PseudoRandomStream::cache();
+    const auto default_capacity = cache.capacity();
+
+    vector<mpz_class> expected_outputs;
+    for (const auto mode : {PRFMode::stream, PRFMode::counter}) {
+        PseudoRandomStream::reset_cache();
+        const PseudoRandomStream stream(1000, 42, mode);
+        for (size_t i = 0; i < 5; ++i) {
+            expected_outputs.push_back(stream.next());
+        }
+    }
+    BOOST_CHECK_GT(cache.statistics().entries, 0);
+
+    // Values are recomputed on every request
+    cache.set_capacity(0);
+    BOOST_CHECK_EQUAL(cache.statistics().entries, 0);
+
+    size_t i = 0;
+    for (const auto mode : {PRFMode::stream, PRFMode::counter}) {
+        const PseudoRandomStream stream(1000, 42, mode);
+        for (size_t j = 0; j < 5; ++j) {
+            BOOST_CHECK(stream.next() == expected_outputs[i++]);
+        }
+        stream.reset();
+        BOOST_CHECK(stream.next() == expected_outputs[i - 5]);
+    }
+    BOOST_CHECK_EQUAL(cache.statistics().entries, 0);
+
+    cache.set_capacity(default_capacity);
+}
+
+BOOST_AUTO_TEST_CASE(prf_stream_partially_evicted_cache)
+{
+    auto & cache = PseudoRandomStream::cache();
+    const auto default_capacity = cache.capacity();
+
+    PseudoRandomStream::reset_cache();
+    const PseudoRandomStream first_stream(1000, 7);
+
+    vector<mpz_class> expected_outputs;
+    for (size_t i = 0; i < 10; ++i) {
+        expected_outputs.push_back(first_stream.next());
+    }
+
+    // Keep only the most recent values, a fresh stream has to regenerate the rest
+    cache.set_capacity(cache.statistics().bytes / 2);
+
+    const PseudoRandomStream second_stream(1000, 7);
+    for (size_t i = 0; i < 10; ++i) {
+        BOOST_CHECK(second_stream.next() == expected_outputs[i]);
+    }
+
+    cache.set_capacity(default_capacity);
+}
+
+BOOST_AUTO_TEST_CASE(prf_cache_concurrent_access)
+{
+    const PseudoRandomFunction prf(1000, 42);
+    const PseudoRandomStream stream(1000, 42, PRFMode::counter);
+
+    auto & cache = PseudoRandomStream::cache();
+    const auto default_capacity = cache.capacity();
+    cache.set_capacity(cache.statistics().bytes + 16 * sizeof(mpz_class) + 16 * 1000 / 8);
+
+    ThreadPool pool(4);
+    atomic<size_t> mismatches(0);
+    pool.parallel_for(400, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (stream.at(i % 40) != prf(i % 40)) {
+                ++mismatches;
+            }
+        }
+    });
+
+    BOOST_CHECK_EQUAL(mismatches, 0);
+    BOOST_CHECK_LE(cache.statistics().bytes, cache.capacity());
+
+    cache.set_capacity(default_capacity);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_SUITE(PseudoRandomFunctionSuite)
+
+BOOST_AUTO_TEST_CASE(prf_output_size)
+{
+    for (const unsigned int bits : {1, 31, 32, 33, 512, 1000}) {
+        const PseudoRandomFunction prf(bits, 42);
+        for (size_t i = 0; i < 10; ++i) {
+            BOOST_CHECK(prf(i) < mpz_class(1) << bits);
+        }
+    }
+
+    // Outputs use the full range
+    const PseudoRandomFunction prf(1000, 42);
+    BOOST_CHECK(prf(0) > mpz_class(1) << 900);
+}
+
+BOOST_AUTO_TEST_CASE(prf_determinism)
+{
+    const PseudoRandomFunction prf(1000, 42), same_prf(1000, 42), other_seed_prf(1000, 43),
+                               other_size_prf(1001, 42);
+
+    for (size_t i = 0; i < 5; ++i) {
+        BOOST_CHECK(prf(i) == same_prf(i));
+        BOOST_CHECK(prf(i) != other_seed_prf(i));
+        BOOST_CHECK(prf(i) != other_size_prf(i));
+        BOOST_CHECK(prf(i) != prf(i + 1));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(prf_stream_counter_mode)
+{
+    const PseudoRandomFunction prf(1000, 42);
+    const PseudoRandomStream stream(1000, 42, PRFMode::counter);
+    const PseudoRandomStream legacy_stream(1000, 42);
+
+    BOOST_CHECK(stream.random_access());
+    BOOST_CHECK(!legacy_stream.random_access());
+
+    for (size_t i = 0; i < 5; ++i) {
+        BOOST_CHECK(stream.next() == prf(i));
+    }
+
+    BOOST_CHECK(stream.at(3) == prf(3));
+    BOOST_CHECK(stream.at(1000000) == prf(1000000));
+    BOOST_CHECK_THROW(legacy_stream.at(3), precondition_not_satisfied);
+
+    stream.reset();
+    BOOST_CHECK(stream.next() == prf(0));
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ReductionModule
+#include <cstddef>
+#include <boost/test/unit_test.hpp>
+
+#include <gmpxx.h>
+
+#include "she/reduction.hpp"
+#include "she/exceptions.hpp"
+
+using std::vector;
+
+using she::precondition_not_satisfied;
+using she::ReductionContext;
+
+
+BOOST_AUTO_TEST_SUITE(ReductionContextSuite)
+
+BOOST_AUTO_TEST_CASE(reduction_context_construction)
+{
+    const mpz_class modulus = 1000003;
+    const ReductionContext context(modulus);
+
+    BOOST_CHECK(context.modulus() == modulus);
+    BOOST_CHECK_EQUAL(context.modulus_bits(), 20);
+
+    BOOST_CHECK_THROW(ReductionContext(0), precondition_not_satisfied);
+}
+
+BOOST_AUTO_TEST_CASE(reduction_context_agrees_with_division)
+{
+    gmp_randclass generator(gmp_randinit_default);
+    generator.seed(42);
+
+    const vector<unsigned int> modulus_sizes = {1, 2, 63, 64, 65, 1000, 4096};
+
+    for (const auto bits : modulus_sizes) {
+        const mpz_class modulus = generator.get_z_bits(bits) | (mpz_class(1) << (bits - 1));
+        const ReductionContext context(modulus);
+
+        const mpz_class a = generator.get_z_range(modulus);
+        const mpz_class b = generator.get_z_range(modulus);
+
+        const vector<mpz_class> values = {
+            0,
+            a,
+            modulus,
+            modulus - 1,
+            a + b,
+            4 * modulus - 1,
+            a * b,
+            (modulus - 1) * (modulus - 1),
+            generator.get_z_bits(2 * bits + 1),
+            generator.get_z_bits(5 * bits + 64),
+            -a,
+            -(a * b),
+        };
+
+        for (const auto & value : values) {
+            mpz_class reduced = value;
+            context.reduce(reduced);
+            BOOST_CHECK(reduced == value % modulus);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,23 +9,77 @@
 #include "serialization_formats.hpp"
 
 using std::stringstream;
+using std::vector;
 
 
 BOOST_AUTO_TEST_SUITE(SerializationsSuite)
 
 BOOST_AUTO_TEST_CASE_TEMPLATE(mpz_class_serialization, Format, Formats)
 {
-    mpz_class z = mpz_class(1) << 10000;
+    const vector<mpz_class> values = {
+        mpz_class(1) << 10000,
+        0,
+        1,
+        -1,
+        255,
+        256,
+        -(mpz_class(1) << 10000) + 12345,
+    };
+
+    for (const auto & z : values) {
+        mpz_class restored_z;
+
+        stringstream ss;
+        {
+            typename Format::oarchive oa(ss);
+            oa << BOOST_SERIALIZATION_NVP(z);
+        }
+        {
+            typename Format::iarchive ia(ss);
+            ia >> BOOST_SERIALIZATION_NVP(restored_z);
+        }
+
+        BOOST_CHECK(z == restored_z);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(mpz_class_binary_encoding_size)
+{
+    gmp_randclass generator(gmp_randinit_default);
+    generator.seed(42);
+    const mpz_class z = generator.get_z_bits(1 << 16);
+
+    stringstream binary_ss, text_ss;
+    {
+        binary_oarchive oa(binary_ss);
+        oa << BOOST_SERIALIZATION_NVP(z);
+    }
+    {
+        text_oarchive oa(text_ss);
+        oa << BOOST_SERIALIZATION_NVP(z);
+    }
+
+    // Raw bytes plus a small header
+    BOOST_CHECK_LE(binary_ss.str().size(), (1 << 13) + 128);
+    BOOST_CHECK_LT(binary_ss.str().size(), text_ss.str().size());
+}
+
+BOOST_AUTO_TEST_CASE(mpz_class_version_0_binary_archive)
+{
+    using base62_tag = she::detail::integer_encoding_tag<she::IntegerEncoding::base62>;
+
+    // Binary archives written before the binary encoding hold base-62 strings
+    const mpz_class z = (mpz_class(1) << 1000) - 1;
     mpz_class restored_z;
 
     stringstream ss;
     {
-        typename Format::oarchive oa(ss);
-        oa << BOOST_SERIALIZATION_NVP(z);
+        binary_oarchive oa(ss);
+        she::detail::save_integer(oa, z, base62_tag());
     }
     {
-        typename Format::iarchive ia(ss);
-        ia >> BOOST_SERIALIZATION_NVP(restored_z);
+        binary_iarchive ia(ss);
+        boost::serialization::load(ia, restored_z, 0);
     }
 
     BOOST_CHECK(z == restored_z);
@@ -0,0 +1,189 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE StoreModule
+#include <cstddef>
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "she.hpp"
+#include "she/store.hpp"
+#include "she/exceptions.hpp"
+
+using std::string;
+using std::vector;
+
+using she::precondition_not_satisfied;
+using she::PrivateKey;
+using she::ParameterSet;
+using she::EncryptedArray;
+using she::EncryptedArrayStore;
+
+
+string temporary_path()
+{
+    char path[] = "/tmp/she_store_XXXXXX";
+    const int fd = mkstemp(path);
+    close(fd);
+    return path;
+}
+
+
+BOOST_AUTO_TEST_SUITE(EncryptedArrayStoreSuite)
+
+BOOST_AUTO_TEST_CASE(store_roundtrip)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const auto path = temporary_path();
+
+    const vector<vector<bool> > raw_arrays = {
+        {1, 0, 1, 1},
+        {},
+        {0, 1},
+        {1, 1, 1, 0, 1},
+    };
+
+    vector<EncryptedArray> arrays;
+    for (const auto & raw_array : raw_arrays) {
+        arrays.push_back(sk.encrypt(raw_array).expand());
+    }
+    arrays[3] &= arrays[3];
+    arrays[3].set_lazy_reduction(64);
+    arrays[3] ^= arrays[3];
+    arrays[3] ^= arrays[3];
+
+    EncryptedArrayStore::write(path, arrays);
+    const EncryptedArrayStore store(path);
+
+    BOOST_CHECK_EQUAL(store.size(), arrays.size());
+    BOOST_CHECK_EQUAL(store.max_degree(), arrays[0].max_degree());
+    BOOST_CHECK_EQUAL(store.noise_limit(), arrays[0].noise_limit());
+    BOOST_CHECK(store.public_element() == arrays[0].public_element());
+    BOOST_CHECK(store.context() == arrays[0].context());
+
+    for (size_t i = 0; i < arrays.size(); ++i) {
+        const auto view = store[i];
+        BOOST_CHECK_EQUAL(view.size(), arrays[i].size());
+        BOOST_CHECK_EQUAL(view.degree(), arrays[i].degree());
+
+        auto expected = arrays[i];
+        expected.normalize();
+
+        const auto loaded = view.load();
+        BOOST_CHECK(loaded == expected);
+        BOOST_CHECK_EQUAL(loaded.degree(), arrays[i].degree());
+
+        // Noise bounds are stored rounded up
+        BOOST_CHECK_EQUAL(view.noise_bits(), std::ceil(arrays[i].noise_bits()));
+        BOOST_CHECK_EQUAL(loaded.noise_bits(), view.noise_bits());
+
+        for (size_t j = 0; j < view.size(); ++j) {
+            mpz_t storage;
+            BOOST_CHECK_EQUAL(mpz_cmp(view.element(j, storage), expected.elements()[j].get_mpz_t()), 0);
+        }
+
+        mpz_t storage;
+        BOOST_CHECK_THROW(view.element(view.size(), storage), precondition_not_satisfied);
+    }
+
+    BOOST_CHECK_THROW(store[store.size()], precondition_not_satisfied);
+
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(store_select)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const auto path = temporary_path();
+
+    const vector<vector<bool> > raw_arrays = {
+        {1, 0, 1, 1},
+        {0, 1, 0},
+        {1, 1, 1, 0, 1},
+    };
+
+    vector<EncryptedArray> arrays;
+    for (const auto & raw_array : raw_arrays) {
+        arrays.push_back(sk.encrypt(raw_array).expand());
+    }
+
+    // Arrays are written one at a time
+    {
+        EncryptedArrayStore::Writer writer(path, arrays[0].context(), arrays[0].max_degree());
+        for (const auto & array : arrays) {
+            writer.append(array);
+        }
+    }
+    const EncryptedArrayStore store(path);
+
+    for (size_t index = 0; index < raw_arrays.size(); ++index) {
+        vector<bool> raw_selector(raw_arrays.size(), 0);
+        raw_selector[index] = 1;
+        const auto selector = sk.encrypt(raw_selector).expand();
+
+        const auto stored_result = selector.select(store);
+        const auto result = selector.select(arrays);
+
+        auto expected = raw_arrays[index];
+        expected.resize(5, 0);
+
+        BOOST_CHECK(sk.decrypt(stored_result) == expected);
+        BOOST_CHECK(stored_result == result);
+        BOOST_CHECK_EQUAL(stored_result.degree(), result.degree());
+        BOOST_CHECK(stored_result.noise_bits() >= result.noise_bits());
+        BOOST_CHECK(stored_result.noise_bits() <= result.noise_bits() + 1);
+    }
+
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(store_rejects_invalid_input)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const PrivateKey other_sk(ParameterSet::generate_parameter_set(22, 5, 43));
+    const auto path = temporary_path();
+
+    const auto array = sk.encrypt({1, 0, 1}).expand();
+    const auto other_array = other_sk.encrypt({1, 0, 1}).expand();
+
+    // Arrays under another public element
+    BOOST_CHECK_THROW(EncryptedArrayStore::write(path, {array, other_array}), precondition_not_satisfied);
+
+    BOOST_CHECK_THROW(EncryptedArrayStore(path + ".missing"), precondition_not_satisfied);
+
+    // Truncated store
+    EncryptedArrayStore::write(path, {array});
+    truncate(path.c_str(), sizeof(EncryptedArrayStore::Header) + 10);
+    BOOST_CHECK_THROW(EncryptedArrayStore{path}, precondition_not_satisfied);
+
+    // Header fields whose sizes wrap around to the size of the file. Records take 24 bytes and
+    // limbs 8, so 2^61 more of either wrap
+    const auto patch = [&](size_t offset, uint64_t value) {
+        EncryptedArrayStore::write(path, {array});
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offset);
+        file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+
+    patch(offsetof(EncryptedArrayStore::Header, count), 1 + (uint64_t(1) << 61));
+    BOOST_CHECK_THROW(EncryptedArrayStore{path}, precondition_not_satisfied);
+
+    const uint64_t stride = mpz_size(array.public_element().get_mpz_t());
+    patch(offsetof(EncryptedArrayStore::Header, stride), stride + (uint64_t(1) << 61));
+    BOOST_CHECK_THROW(EncryptedArrayStore{path}, precondition_not_satisfied);
+
+    patch(offsetof(EncryptedArrayStore::Header, table_offset), uint64_t(-8));
+    BOOST_CHECK_THROW(EncryptedArrayStore{path}, precondition_not_satisfied);
+
+    // Not a store
+    std::ofstream(path) << string(1024, 'x');
+    BOOST_CHECK_THROW(EncryptedArrayStore{path}, precondition_not_satisfied);
+
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,195 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE StreamModule
+#include <cstddef>
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+
+#include "she.hpp"
+#include "she/stream.hpp"
+#include "she/exceptions.hpp"
+
+using std::stringstream;
+using std::vector;
+
+using she::precondition_not_satisfied;
+using she::PRFMode;
+using she::PrivateKey;
+using she::ParameterSet;
+using she::EncryptedArray;
+using she::EncryptedArrayReader;
+using she::EncryptedArrayWriter;
+using she::CompressedCiphertextReader;
+using she::CompressedCiphertextWriter;
+
+
+BOOST_AUTO_TEST_SUITE(StreamSuite)
+
+BOOST_AUTO_TEST_CASE(encrypted_array_stream_roundtrip)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const vector<bool> bits = {1, 0, 1, 1, 0, 0, 1};
+
+    const auto array = sk.encrypt(bits).expand();
+    auto lazy_array = array;
+    lazy_array.set_lazy_reduction(64);
+    lazy_array ^= array;
+    lazy_array ^= array;
+
+    for (const auto & source : {array, lazy_array}) {
+        stringstream ss;
+        EncryptedArrayWriter writer(ss, source);
+        BOOST_CHECK_EQUAL(writer.remaining(), 0);
+
+        EncryptedArrayReader reader(ss);
+        BOOST_CHECK_EQUAL(reader.size(), bits.size());
+        BOOST_CHECK_EQUAL(reader.degree(), source.degree());
+        BOOST_CHECK_EQUAL(reader.max_degree(), source.max_degree());
+        BOOST_CHECK(reader.context() == source.context());
+
+        const auto restored = reader.read();
+        BOOST_CHECK(sk.decrypt(restored) == bits);
+        BOOST_CHECK_EQUAL(reader.remaining(), 0);
+        BOOST_CHECK_EQUAL(restored.noise_bits(), source.noise_bits());
+        BOOST_CHECK_EQUAL(restored.noise_limit(), source.noise_limit());
+
+        // Elements are congruent to the source, and no larger than the public element
+        auto normalized = source, normalized_restored = restored;
+        BOOST_CHECK(normalized_restored.normalize() == normalized.normalize());
+        for (const auto & element : restored.elements()) {
+            BOOST_CHECK_LE(mpz_sizeinbase(element.get_mpz_t(), 2),
+                           mpz_sizeinbase(restored.public_element().get_mpz_t(), 2));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(encrypted_array_stream_incremental)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const auto array = sk.encrypt({0, 1, 1}).expand();
+
+    // Elements are written as they are computed, and read one at a time
+    stringstream ss;
+    EncryptedArrayWriter writer(ss, array.context(), array.size(), array.max_degree(), array.degree());
+    for (const auto & element : array.elements()) {
+        writer.write(element);
+    }
+    BOOST_CHECK_THROW(writer.write(array.elements().front()), precondition_not_satisfied);
+
+    EncryptedArrayReader reader(ss);
+    mpz_class element;
+    for (size_t i = 0; i < array.size(); ++i) {
+        BOOST_CHECK(reader.next(element));
+        BOOST_CHECK(element == array.elements()[i]);
+        BOOST_CHECK_EQUAL(reader.remaining(), array.size() - i - 1);
+    }
+    BOOST_CHECK(!reader.next(element));
+}
+
+BOOST_AUTO_TEST_CASE(compressed_ciphertext_stream_expansion)
+{
+    const vector<bool> bits = {1, 1, 0, 1, 0, 0, 1, 0};
+
+    for (const auto mode : {PRFMode::stream, PRFMode::counter}) {
+        const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42, mode));
+        const auto ciphertext = sk.encrypt(bits);
+
+        stringstream ss;
+        CompressedCiphertextWriter writer(ss, ciphertext);
+
+        CompressedCiphertextReader reader(ss);
+        BOOST_CHECK(reader.parameter_set() == sk.parameter_set());
+        BOOST_CHECK_EQUAL(reader.size(), bits.size());
+
+        // Expand the first element before the rest is consumed
+        mpz_class first_element;
+        BOOST_CHECK(reader.next(first_element));
+
+        const auto rest = reader.expand();
+        const auto expected = ciphertext.expand();
+
+        BOOST_CHECK(first_element == expected.elements().front());
+        BOOST_CHECK_EQUAL(rest.size(), bits.size() - 1);
+        BOOST_CHECK(rest.public_element() == expected.public_element());
+        BOOST_CHECK(sk.decrypt(rest) == vector<bool>(bits.begin() + 1, bits.end()));
+        BOOST_CHECK_EQUAL(rest.noise_bits(), expected.noise_bits());
+        BOOST_CHECK_EQUAL(rest.noise_limit(), expected.noise_limit());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(encrypted_array_stream_version_1)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const vector<bool> bits = {1, 0, 1};
+    const auto array = sk.encrypt(bits).expand();
+
+    stringstream ss;
+    EncryptedArrayWriter writer(ss, array);
+
+    // Version 1 header has no noise bound and limit after the degree
+    const auto current = ss.str();
+    stringstream old(current.substr(0, 4) + std::string("\x01\0\0\0", 4) + current.substr(8, 16) + current.substr(36));
+
+    EncryptedArrayReader reader(old);
+    BOOST_CHECK_EQUAL(reader.noise_limit(), 0);
+
+    const auto restored = reader.read();
+    BOOST_CHECK(sk.decrypt(restored) == bits);
+    BOOST_CHECK_EQUAL(restored.noise_bits(), 0);
+    BOOST_CHECK_EQUAL(restored.noise_limit(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(stream_rejects_invalid_input)
+{
+    const PrivateKey sk(ParameterSet::generate_parameter_set(22, 5, 42));
+    const auto array = sk.encrypt({0, 1, 1}).expand();
+
+    // Wrong kind of stream
+    stringstream ss;
+    EncryptedArrayWriter writer(ss, array);
+    BOOST_CHECK_THROW(CompressedCiphertextReader{ss}, precondition_not_satisfied);
+
+    // Truncated stream
+    stringstream complete;
+    EncryptedArrayWriter complete_writer(complete, array);
+    stringstream truncated(complete.str().substr(0, complete.str().size() - 10));
+
+    EncryptedArrayReader reader(truncated);
+    BOOST_CHECK_THROW(reader.read(), precondition_not_satisfied);
+
+    // Header offsets: magic, version, size, maximum degree, degree, noise bound and limit, then the
+    // public element as sign, byte length and magnitude
+    const auto bytes = complete.str();
+    const auto patch = [&](std::string stream, size_t offset, size_t size, char value) {
+        stream.replace(offset, size, size, value);
+        return stream;
+    };
+
+    // Huge element count is not allocated upfront, the stream just ends
+    stringstream huge_count(patch(bytes, 8, 8, '\x7f'));
+    EncryptedArrayReader huge_count_reader(huge_count);
+    BOOST_CHECK_THROW(huge_count_reader.read(), precondition_not_satisfied);
+
+    // Integers longer than the public element allows
+    stringstream huge_public_element(patch(bytes, 37, 8, '\x7f'));
+    BOOST_CHECK_THROW(EncryptedArrayReader{huge_public_element}, precondition_not_satisfied);
+
+    const size_t public_element_bytes = (mpz_sizeinbase(array.public_element().get_mpz_t(), 2) + 7) / 8;
+    stringstream huge_element(patch(bytes, 37 + 8 + public_element_bytes + 1, 8, '\x01'));
+    EncryptedArrayReader huge_element_reader(huge_element);
+    mpz_class element;
+    BOOST_CHECK_THROW(huge_element_reader.next(element), precondition_not_satisfied);
+
+    // Inconsistent parameter sets: magic, version, security, noise, private key and ciphertext sizes
+    stringstream compressed;
+    CompressedCiphertextWriter compressed_writer(compressed, sk.encrypt({0, 1, 1}));
+    const auto compressed_bytes = compressed.str();
+
+    stringstream zero_ciphertext_size(patch(compressed_bytes, 20, 4, '\0'));
+    BOOST_CHECK_THROW(CompressedCiphertextReader{zero_ciphertext_size}, precondition_not_satisfied);
+
+    stringstream zero_security(patch(compressed_bytes, 8, 4, '\0'));
+    BOOST_CHECK_THROW(CompressedCiphertextReader{zero_security}, precondition_not_satisfied);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
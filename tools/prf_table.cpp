@@ -0,0 +1,50 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "she/prf_table.hpp"
+#include "she/exceptions.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+using she::PRFMode;
+using she::PRFTable;
+
+
+// Precomputes the pseudo-random values of a parameter set. The table has to cover the
+// public element and every ciphertext element, that is `count` = elements + 1
+int main(int argc, char * argv[])
+{
+    if (argc < 5 || argc > 6) {
+        cerr << "Usage: " << argv[0] << " OUTPUT CIPHERTEXT_SIZE_BITS PRF_SEED COUNT [stream|counter]"
+             << endl;
+        return 1;
+    }
+
+    const string path = argv[1];
+    const unsigned int size = std::strtoul(argv[2], nullptr, 10);
+    const unsigned int seed = std::strtoul(argv[3], nullptr, 10);
+    const size_t count = std::strtoull(argv[4], nullptr, 10);
+    const string mode_name = (argc == 6) ? argv[5] : "stream";
+
+    if (mode_name != "stream" && mode_name != "counter") {
+        cerr << "Unknown PRF mode: " << mode_name << endl;
+        return 1;
+    }
+    const PRFMode mode = (mode_name == "counter") ? PRFMode::counter : PRFMode::stream;
+
+    try {
+        PRFTable::write(path, size, seed, mode, count);
+        const PRFTable table(path);
+        cout << "Wrote " << table.count() << " values of " << table.size() << " bits to " << path
+             << endl;
+    } catch (const she::precondition_not_satisfied & e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}